@@ -1,58 +1,268 @@
 #include "ccCommon.h"
 #include "sys/time.h"
+#include "time.h"
 
-void MemoryClear(void *dst, int size) {
-    int currentOffset = 0;
-    int mulCount = size / (int) sizeof(long long);
-    for (int i = 0; i < mulCount; ++i) {
-        *((long long *) dst + i) = 0;
-        currentOffset += sizeof(long long);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MEMORY_SIMD_KERNELS
+#include "immintrin.h"
+#endif
+
+//Generic kernels: byte head up to 8-byte alignment of dst, 64-bit body, byte tail.
+//They also serve the SIMD kernels for sizes below one vector.
+
+static uint64 LoadWord(const uint8 *src) {
+    uint64 word;
+    for (int i = 0; i < (int) sizeof(uint64); ++i)
+        ((uint8 *) &word)[i] = src[i];
+    return word;
+}
+
+static void ClearGeneric(uint8 *dst, size_t size) {
+    size_t offset = 0;
+    while (offset < size && ((size_t) (dst + offset) & 7) != 0)
+        dst[offset++] = 0;
+    for (; offset + 8 <= size; offset += 8)
+        *(uint64 *) (dst + offset) = 0;
+    while (offset < size)
+        dst[offset++] = 0;
+}
+
+static void CopyGeneric(const uint8 *src, uint8 *dst, size_t size) {
+    size_t offset = 0;
+    while (offset < size && ((size_t) (dst + offset) & 7) != 0) {
+        dst[offset] = src[offset];
+        offset++;
     }
-    while (currentOffset < size) {
-        *((char *) dst + currentOffset) = 0;
-        currentOffset += 1;
+    for (; offset + 8 <= size; offset += 8)
+        *(uint64 *) (dst + offset) = LoadWord(src + offset);
+    while (offset < size) {
+        dst[offset] = src[offset];
+        offset++;
     }
 }
 
-void MemoryCopy(void *src, void *dst, int size) {
-    int currentOffset = 0;
-    int mulCount = size / (int) sizeof(long long);
-    for (int i = 0; i < mulCount; ++i) {
-        *((long long *) dst + i) = *((long long *) src + i);
-        currentOffset += sizeof(long long);
+static void CopyReversedGeneric(const uint8 *src, uint8 *dst, size_t size) {
+    size_t offset = size;
+    while (offset > 0 && ((size_t) (dst + offset) & 7) != 0) {
+        offset--;
+        dst[offset] = src[offset];
+    }
+    while (offset >= 8) {
+        offset -= 8;
+        *(uint64 *) (dst + offset) = LoadWord(src + offset);
     }
-    while (currentOffset < size) {
-        *((char *) dst + currentOffset) = *((char *) src + currentOffset);
-        currentOffset += 1;
+    while (offset > 0) {
+        offset--;
+        dst[offset] = src[offset];
     }
 }
 
-void MemoryCopyReversed(void *src, void *dst, int size) {
-    int currentOffset = size - 1;
-    int mulCount = size / (int) sizeof(long long);
-    int sigCount = size % (int) sizeof(long long);
-    for (int i = 0; i < sigCount; ++i) {
-        *((char *) dst + currentOffset) = *((char *) src + currentOffset);
-        currentOffset -= 1;
-    }
-    for (int i = mulCount - 1; i >= 0; --i)
-        *((long long *) dst + i) = *((long long *) src + i);
+static int CompareGeneric(const uint8 *src, const uint8 *dst, size_t size) {
+    size_t offset = 0;
+    for (; offset + 8 <= size; offset += 8)
+        if (LoadWord(src + offset) != LoadWord(dst + offset))
+            break;
+    for (; offset < size; ++offset)
+        if (src[offset] != dst[offset])
+            return (int) src[offset] - (int) dst[offset];
+    return 0;
 }
 
-bool MemoryEqual(void *src, void *dst, int size) {
-    int currentOffset = 0;
-    int mulCount = size / (int) sizeof(long long);
-    for (int i = 0; i < mulCount; ++i) {
-        if (*((long long *) dst + i) != *((long long *) src + i))
-            return false;
-        currentOffset += sizeof(long long);
-    }
-    while (currentOffset < size) {
-        if (*((char *) dst + currentOffset) != *((char *) src + currentOffset))
-            return false;
-        currentOffset += 1;
+typedef struct {
+    void (*clear)(uint8 *dst, size_t size);
+    void (*copy)(const uint8 *src, uint8 *dst, size_t size);
+    void (*copyReversed)(const uint8 *src, uint8 *dst, size_t size);
+    int (*compare)(const uint8 *src, const uint8 *dst, size_t size);
+    const char *name;
+} MemoryKernels;
+
+static MemoryKernels memoryKernels = {ClearGeneric, CopyGeneric, CopyReversedGeneric, CompareGeneric, "generic"};
+
+#ifdef MEMORY_SIMD_KERNELS
+
+//Every SIMD kernel covers the first and the last vector with unaligned accesses and the body between them with
+//accesses aligned on dst. Copies load the first and last vector before storing anything, so MemoryCopy stays
+//correct when dst < src and MemoryCopyReversed when dst > src even if the ranges overlap.
+#define DEFINE_MEMORY_KERNELS(ISA, TARGET, WIDTH)                                                              \
+__attribute__((target(TARGET))) static void Clear##ISA(uint8 *dst, size_t size) {                              \
+    if (size < WIDTH) {                                                                                         \
+        ClearGeneric(dst, size);                                                                                \
+        return;                                                                                                 \
+    }                                                                                                           \
+    Vec##ISA zero = Zero##ISA();                                                                                \
+    Store##ISA(dst, zero);                                                                                      \
+    size_t offset = WIDTH - ((size_t) dst & (WIDTH - 1));                                                       \
+    if (size >= MEMORY_NON_TEMPORAL_THRESHOLD) {                                                                \
+        for (; offset + WIDTH <= size; offset += WIDTH)                                                         \
+            Stream##ISA(dst + offset, zero);                                                                    \
+        _mm_sfence();                                                                                           \
+    } else {                                                                                                    \
+        for (; offset + WIDTH <= size; offset += WIDTH)                                                         \
+            StoreAligned##ISA(dst + offset, zero);                                                              \
+    }                                                                                                           \
+    Store##ISA(dst + size - WIDTH, zero);                                                                       \
+}                                                                                                               \
+                                                                                                                \
+__attribute__((target(TARGET))) static void Copy##ISA(const uint8 *src, uint8 *dst, size_t size) {             \
+    if (size < WIDTH) {                                                                                         \
+        CopyGeneric(src, dst, size);                                                                            \
+        return;                                                                                                 \
+    }                                                                                                           \
+    Vec##ISA head = Load##ISA(src), tail = Load##ISA(src + size - WIDTH);                                       \
+    for (size_t offset = WIDTH - ((size_t) dst & (WIDTH - 1)); offset + WIDTH <= size; offset += WIDTH)         \
+        StoreAligned##ISA(dst + offset, Load##ISA(src + offset));                                               \
+    Store##ISA(dst, head);                                                                                      \
+    Store##ISA(dst + size - WIDTH, tail);                                                                       \
+}                                                                                                               \
+                                                                                                                \
+__attribute__((target(TARGET))) static void CopyReversed##ISA(const uint8 *src, uint8 *dst, size_t size) {     \
+    if (size < WIDTH) {                                                                                         \
+        CopyReversedGeneric(src, dst, size);                                                                    \
+        return;                                                                                                 \
+    }                                                                                                           \
+    Vec##ISA head = Load##ISA(src), tail = Load##ISA(src + size - WIDTH);                                       \
+    size_t offset = size - ((size_t) (dst + size) & (WIDTH - 1));                                               \
+    while (offset > WIDTH) {                                                                                    \
+        offset -= WIDTH;                                                                                        \
+        StoreAligned##ISA(dst + offset, Load##ISA(src + offset));                                               \
+    }                                                                                                           \
+    Store##ISA(dst + size - WIDTH, tail);                                                                       \
+    Store##ISA(dst, head);                                                                                      \
+}                                                                                                               \
+                                                                                                                \
+__attribute__((target(TARGET))) static int Compare##ISA(const uint8 *src, const uint8 *dst, size_t size) {     \
+    if (size < WIDTH)                                                                                           \
+        return CompareGeneric(src, dst, size);                                                                  \
+    uint64 mask = DiffMask##ISA(Load##ISA(src), Load##ISA(dst));                                                \
+    if (mask != 0)                                                                                              \
+        return ByteOrder(src, dst, __builtin_ctzll(mask));                                                      \
+    for (size_t offset = WIDTH - ((size_t) dst & (WIDTH - 1)); offset + WIDTH <= size; offset += WIDTH) {       \
+        mask = DiffMask##ISA(Load##ISA(src + offset), Load##ISA(dst + offset));                                 \
+        if (mask != 0)                                                                                          \
+            return ByteOrder(src, dst, offset + __builtin_ctzll(mask));                                         \
+    }                                                                                                           \
+    mask = DiffMask##ISA(Load##ISA(src + size - WIDTH), Load##ISA(dst + size - WIDTH));                         \
+    if (mask != 0)                                                                                              \
+        return ByteOrder(src, dst, size - WIDTH + __builtin_ctzll(mask));                                       \
+    return 0;                                                                                                   \
+}
+
+static int ByteOrder(const uint8 *src, const uint8 *dst, size_t offset) {
+    return (int) src[offset] - (int) dst[offset];
+}
+
+#define SSE2_TARGET "sse2"
+typedef __m128i VecSSE2;
+__attribute__((target(SSE2_TARGET))) static inline VecSSE2 ZeroSSE2(void) {
+    return _mm_setzero_si128();
+}
+__attribute__((target(SSE2_TARGET))) static inline VecSSE2 LoadSSE2(const uint8 *p) {
+    return _mm_loadu_si128((const __m128i *) p);
+}
+__attribute__((target(SSE2_TARGET))) static inline void StoreSSE2(uint8 *p, VecSSE2 v) {
+    _mm_storeu_si128((__m128i *) p, v);
+}
+__attribute__((target(SSE2_TARGET))) static inline void StoreAlignedSSE2(uint8 *p, VecSSE2 v) {
+    _mm_store_si128((__m128i *) p, v);
+}
+__attribute__((target(SSE2_TARGET))) static inline void StreamSSE2(uint8 *p, VecSSE2 v) {
+    _mm_stream_si128((__m128i *) p, v);
+}
+__attribute__((target(SSE2_TARGET))) static inline uint64 DiffMaskSSE2(VecSSE2 a, VecSSE2 b) {
+    return (uint64) (~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xFFFF);
+}
+DEFINE_MEMORY_KERNELS(SSE2, SSE2_TARGET, 16)
+
+#define AVX2_TARGET "avx2"
+typedef __m256i VecAVX2;
+__attribute__((target(AVX2_TARGET))) static inline VecAVX2 ZeroAVX2(void) {
+    return _mm256_setzero_si256();
+}
+__attribute__((target(AVX2_TARGET))) static inline VecAVX2 LoadAVX2(const uint8 *p) {
+    return _mm256_loadu_si256((const __m256i *) p);
+}
+__attribute__((target(AVX2_TARGET))) static inline void StoreAVX2(uint8 *p, VecAVX2 v) {
+    _mm256_storeu_si256((__m256i *) p, v);
+}
+__attribute__((target(AVX2_TARGET))) static inline void StoreAlignedAVX2(uint8 *p, VecAVX2 v) {
+    _mm256_store_si256((__m256i *) p, v);
+}
+__attribute__((target(AVX2_TARGET))) static inline void StreamAVX2(uint8 *p, VecAVX2 v) {
+    _mm256_stream_si256((__m256i *) p, v);
+}
+__attribute__((target(AVX2_TARGET))) static inline uint64 DiffMaskAVX2(VecAVX2 a, VecAVX2 b) {
+    return (uint64) (uint32) ~_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+}
+DEFINE_MEMORY_KERNELS(AVX2, AVX2_TARGET, 32)
+
+#define AVX512_TARGET "avx512f,avx512bw"
+typedef __m512i VecAVX512;
+__attribute__((target(AVX512_TARGET))) static inline VecAVX512 ZeroAVX512(void) {
+    return _mm512_setzero_si512();
+}
+__attribute__((target(AVX512_TARGET))) static inline VecAVX512 LoadAVX512(const uint8 *p) {
+    return _mm512_loadu_si512(p);
+}
+__attribute__((target(AVX512_TARGET))) static inline void StoreAVX512(uint8 *p, VecAVX512 v) {
+    _mm512_storeu_si512(p, v);
+}
+__attribute__((target(AVX512_TARGET))) static inline void StoreAlignedAVX512(uint8 *p, VecAVX512 v) {
+    _mm512_store_si512(p, v);
+}
+__attribute__((target(AVX512_TARGET))) static inline void StreamAVX512(uint8 *p, VecAVX512 v) {
+    _mm512_stream_si512((__m512i *) p, v);
+}
+__attribute__((target(AVX512_TARGET))) static inline uint64 DiffMaskAVX512(VecAVX512 a, VecAVX512 b) {
+    return ~(uint64) _mm512_cmpeq_epi8_mask(a, b);
+}
+DEFINE_MEMORY_KERNELS(AVX512, AVX512_TARGET, 64)
+
+__attribute__((constructor)) static void SelectMemoryKernels(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        MemoryKernels kernels = {ClearAVX512, CopyAVX512, CopyReversedAVX512, CompareAVX512, "avx512"};
+        memoryKernels = kernels;
+    } else if (__builtin_cpu_supports("avx2")) {
+        MemoryKernels kernels = {ClearAVX2, CopyAVX2, CopyReversedAVX2, CompareAVX2, "avx2"};
+        memoryKernels = kernels;
+    } else if (__builtin_cpu_supports("sse2")) {
+        MemoryKernels kernels = {ClearSSE2, CopySSE2, CopyReversedSSE2, CompareSSE2, "sse2"};
+        memoryKernels = kernels;
     }
-    return true;
+}
+
+#endif
+
+void MemoryClear(void *dst, size_t size) {
+    memoryKernels.clear(dst, size);
+}
+
+void MemoryCopy(void *src, void *dst, size_t size) {
+    memoryKernels.copy(src, dst, size);
+}
+
+void MemoryCopyReversed(void *src, void *dst, size_t size) {
+    memoryKernels.copyReversed(src, dst, size);
+}
+
+void MemoryMove(void *src, void *dst, size_t size) {
+    //Copying forwards is only unsafe when dst starts inside [src, src + size).
+    if ((size_t) ((uint8 *) dst - (uint8 *) src) >= size)
+        memoryKernels.copy(src, dst, size);
+    else
+        memoryKernels.copyReversed(src, dst, size);
+}
+
+int MemoryCompare(void *src, void *dst, size_t size) {
+    return memoryKernels.compare(src, dst, size);
+}
+
+bool MemoryEqual(void *src, void *dst, size_t size) {
+    return memoryKernels.compare(src, dst, size) == 0;
+}
+
+const char *MemoryKernelName(void) {
+    return memoryKernels.name;
 }
 
 uint64 GetTimeMicroSeconds() {
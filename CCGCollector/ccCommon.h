@@ -1,3 +1,8 @@
+#ifndef INC_CC_COMMON
+#define INC_CC_COMMON
+
+#include <stddef.h>
+
 #define true  1
 #define false 0
 
@@ -14,12 +19,27 @@ typedef unsigned int uint32;
 typedef unsigned long long uint64;
 
 
-void MemoryClear(void *dst, int size);
+//The memory primitives dispatch to SSE2/AVX2/AVX-512 kernels picked once at startup through CPUID.
+//MemoryCopy copies forwards and MemoryCopyReversed backwards, MemoryMove picks the direction that is safe for
+//overlapping ranges. Clears of at least MEMORY_NON_TEMPORAL_THRESHOLD bytes bypass the cache.
+
+#define MEMORY_NON_TEMPORAL_THRESHOLD ((size_t) 4 << 20)
+
+void MemoryClear(void *dst, size_t size);
+
+void MemoryCopy(void *src, void *dst, size_t size);
+
+void MemoryCopyReversed(void *src, void *dst, size_t size);
+
+void MemoryMove(void *src, void *dst, size_t size);
+
+//Returns <0, 0 or >0 like memcmp, comparing bytes as unsigned.
+int MemoryCompare(void *src, void *dst, size_t size);
 
-void MemoryCopy(void *src, void *dst, int size);
+bool MemoryEqual(void *src, void *dst, size_t size);
 
-void MemoryCopyReversed(void *src, void *dst, int size);
+const char *MemoryKernelName(void);
 
-bool MemoryEqual(void *src, void *dst, int size);
+uint64 GetTimeMicroSeconds();
 
-uint64 GetTimeMicroSeconds();
\ No newline at end of file
+#endif
@@ -0,0 +1,1058 @@
+#include "gCollector.h"
+#include "gcDump.h"
+#include "setjmp.h"
+#include "string.h"
+#include "unistd.h"
+
+#ifdef __GLIBC__
+#include "malloc.h"
+#endif
+
+//A callee-saved register may hold the only reference to an object, spill them into the current frame before the
+//stack is scanned so they are seen as roots.
+#ifdef __GNUC__
+#define SPILL_REGISTERS(env) __builtin_unwind_init(); setjmp(env)
+#else
+#define SPILL_REGISTERS(env) setjmp(env)
+#endif
+
+//Source: https://gist.github.com/badboy/6267743
+int HashAddress(void *address) {
+    uint64 key = (uint64) address;
+    key = (~key) + (key << 18);
+    key = key ^ (key >> 31);
+    key = key * 21;
+    key = key ^ (key >> 11);
+    key = key + (key << 6);
+    key = key ^ (key >> 22);
+    //Masking instead of negating keeps INT_MIN from producing a negative bucket index.
+    return (int) (key & 0x7FFFFFFF);
+}
+
+void InitRecordMap(RecordMap *map) {
+    map->size = 0;
+    map->capacity = 7;
+    map->loadFactor = 0.86;
+    map->entries = malloc(map->capacity * sizeof(RecordEntry));
+    MemoryClear(map->entries, map->capacity * sizeof(RecordEntry));
+}
+
+void FreeRecordMap(RecordMap *map) {
+    for (int i = 0; i < map->capacity; ++i) {
+        RecordEntry *current = (map->entries + i)->next;
+        while (current != NULL) {
+            RecordEntry *next = current->next;
+            free(current);
+            current = next;
+        }
+    }
+    free(map->entries);
+}
+
+RecordEntry *MallocRecordEntry(RecordEntry *src) {
+    RecordEntry *record = (RecordEntry *) malloc(sizeof(RecordEntry));
+    MemoryCopy(src, record, sizeof(RecordEntry));
+    return record;
+}
+
+void Expand(RecordMap *map);
+
+bool AddRecord(RecordMap *map, RecordEntry *entry, bool entryFromHeap) {
+    if ((double) map->size / map->capacity > map->loadFactor)
+        Expand(map);
+    int index = HashAddress(entry->mallocAddr) % map->capacity;
+    if (map->entries[index].mallocAddr == NULL) {
+        map->entries[index] = *entry;
+        if (entryFromHeap)
+            free(entry);
+        map->size += 1;
+        return true;
+    } else {
+        RecordEntry *current = map->entries + index;
+        while (true) {
+            if (current->mallocAddr == entry->mallocAddr)
+                return false;
+            if (current->next != NULL)
+                current = current->next;
+            else
+                break;
+        }
+        current->next = entryFromHeap ? entry : MallocRecordEntry(entry);
+        map->size += 1;
+        return true;
+    }
+}
+
+void Expand(RecordMap *map) {
+    int oldCapacity = map->capacity;
+    RecordEntry *oldEntries = map->entries;
+
+    map->capacity *= 2;
+    map->size = 0;
+    map->entries = malloc(map->capacity * sizeof(RecordEntry));
+    MemoryClear(map->entries, map->capacity * sizeof(RecordEntry));
+
+    for (int i = 0; i < oldCapacity; ++i) {
+        RecordEntry *current = (oldEntries + i);
+        if (current->mallocAddr == 0)
+            continue;
+        RecordEntry *next = current->next;
+        current->next = NULL;
+        AddRecord(map, current, false);
+        current = next;
+        while (current != NULL) {
+            next = current->next;
+            current->next = NULL;
+            AddRecord(map, current, true);
+            current = next;
+        }
+    }
+
+    free(oldEntries);
+}
+
+RecordEntry *GetRecord(RecordMap *map, void *mallocAddr) {
+    int index = HashAddress(mallocAddr) % map->capacity;
+    if (map->entries[index].mallocAddr == NULL) {
+        return NULL;
+    } else {
+        RecordEntry *current = map->entries + index;
+        while (current != NULL) {
+            if (current->mallocAddr == mallocAddr)
+                return current;
+            current = current->next;
+        }
+    }
+    return NULL;
+}
+
+bool RemoveRecord(RecordMap *map, void *mallocAddr) {
+    int index = HashAddress(mallocAddr) % map->capacity;
+    if (map->entries[index].mallocAddr == NULL) {
+        return false;
+    } else {
+        RecordEntry *current = map->entries + index;
+        if (current->mallocAddr == mallocAddr) {
+            if (map->entries[index].next != NULL) {
+                RecordEntry *next = map->entries[index].next;
+                map->entries[index] = *(map->entries[index].next);
+                free(next);
+            } else {
+                map->entries[index].mallocAddr = NULL;
+            }
+            map->size -= 1;
+            return true;
+        }
+        while (current != NULL) {
+            if (current->next && current->next->mallocAddr == mallocAddr) {
+                RecordEntry *newNext = current->next->next;
+                free(current->next);
+                current->next = newNext;
+                map->size -= 1;
+                return true;
+            }
+            current = current->next;
+        }
+    }
+    return false;
+}
+
+void TraverseRecordMap(RecordMap *map, void (*traverseFunc)(RecordEntry *, void *), void *closure) {
+    for (int i = 0; i < map->capacity; ++i) {
+        RecordEntry *current = (map->entries + i);
+        if (current->mallocAddr == 0)
+            continue;
+        while (current != NULL) {
+            traverseFunc(current, closure);
+            current = current->next;
+        }
+    }
+}
+
+void GCInit(GCollector *gCollector, void *pArgc) {
+    InitRecordMap(&gCollector->records);
+    InitRecordMap(&gCollector->roots);
+    //pArgc usually points at an int, align it down so the stack is scanned in whole pointer slots.
+    gCollector->FrameTop = (void *) ((uint64) pArgc & ~(uint64) (sizeof(void *) - 1));
+    gCollector->minAddr = 0;
+    gCollector->maxAddr = 0;
+    gCollector->sectionCount = 0;
+    gCollector->byteCount = 0;
+    gCollector->collectThreshold = 0;
+    MemoryClear(&gCollector->cycleStats, sizeof(GCCycleStats));
+    gCollector->pauseHistory.head = 0;
+    gCollector->pauseHistory.count = 0;
+    gCollector->cycleCallback = NULL;
+    gCollector->cycleClosure = NULL;
+    MemoryClear(&gCollector->pressure, sizeof(GCPressureConfig));
+    MemoryClear(&gCollector->nursery, sizeof(GCNursery));
+}
+
+void FreeChunkTraverser(RecordEntry *entry, void *closure) {
+    free(entry->mallocAddr);
+}
+
+void GCEnd(GCollector *gCollector) {
+    FreeRecordMap(&gCollector->records);
+    FreeRecordMap(&gCollector->roots);
+    GCNursery *nursery = &gCollector->nursery;
+    if (nursery->enabled) {
+        TraverseRecordMap(&nursery->chunkMap, FreeChunkTraverser, NULL);
+        FreeRecordMap(&nursery->chunkMap);
+        FreeRecordMap(&nursery->dirtyCards);
+        free(nursery->chunks);
+        free(nursery->worklist);
+        nursery->enabled = false;
+    }
+}
+
+//Registers [addr, addr + size) as an extra root range scanned on every collection, e.g. a global table.
+bool GCAddRoot(GCollector *gCollector, void *addr, int size) {
+    RecordEntry entry = {addr, size, false, 0};
+    return AddRecord(&gCollector->roots, &entry, false);
+}
+
+bool GCRemoveRoot(GCollector *gCollector, void *addr) {
+    return RemoveRecord(&gCollector->roots, addr);
+}
+
+void GCSetCycleCallback(GCollector *gCollector, GCCycleCallback callback, void *closure) {
+    gCollector->cycleCallback = callback;
+    gCollector->cycleClosure = closure;
+}
+
+bool ReadMemoryValue(const char *path, int64 *value) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    char buffer[32];
+    bool succeeded = fgets(buffer, sizeof(buffer), file) != NULL;
+    fclose(file);
+    if (!succeeded)
+        return false;
+    if (buffer[0] == 'm') {
+        *value = -1;
+        return true;
+    }
+    return sscanf(buffer, "%lld", value) == 1;
+}
+
+#define GC_CGROUP_ROOT "/sys/fs/cgroup"
+
+//Writes the directory of the process's cgroup v2 taken from the "0::<path>" line of /proc/self/cgroup. The path is
+//relative to the cgroup namespace, which is also what is mounted at GC_CGROUP_ROOT.
+bool ResolveCgroupDirectory(char *directory, size_t size) {
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    if (file == NULL)
+        return false;
+    char line[4096];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, "0::/", 4) != 0)
+            continue;
+        line[strcspn(line, "\n")] = '\0';
+        //A cgroup outside of our namespace shows up as "/..", its files are not reachable from here.
+        if (strstr(line + 3, "/..") != NULL)
+            break;
+        found = snprintf(directory, size, "%s%s", GC_CGROUP_ROOT, strcmp(line + 3, "/") == 0 ? "" : line + 3) <
+                (int) size;
+    }
+    fclose(file);
+    return found;
+}
+
+//Reads memory.current of the process's cgroup and the tightest memory.max on the way up to the namespace root, so
+//a limit set on a parent slice applies too; resident set size comes from /proc/self/statm.
+bool GCCgroupMemorySource(GCMemoryStatus *status, void *closure) {
+    status->limit = -1;
+    status->current = -1;
+    status->rss = -1;
+    char directory[4096], path[4096 + 16];
+    if (!ResolveCgroupDirectory(directory, sizeof(directory)))
+        strcpy(directory, GC_CGROUP_ROOT);
+    snprintf(path, sizeof(path), "%s/memory.current", directory);
+    ReadMemoryValue(path, &status->current);
+    while (strlen(directory) >= strlen(GC_CGROUP_ROOT)) {
+        int64 limit = -1;
+        snprintf(path, sizeof(path), "%s/memory.max", directory);
+        if (ReadMemoryValue(path, &limit) && limit > 0 && (status->limit <= 0 || limit < status->limit))
+            status->limit = limit;
+        *strrchr(directory, '/') = '\0';
+    }
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file != NULL) {
+        long long pages, residentPages;
+        if (fscanf(file, "%lld %lld", &pages, &residentPages) == 2)
+            status->rss = residentPages * sysconf(_SC_PAGESIZE);
+        fclose(file);
+    }
+    return status->limit > 0 || status->rss >= 0;
+}
+
+//Reports whatever the GCMemoryStatus passed as closure holds, lets tests script the pressure.
+bool GCSimulatedMemorySource(GCMemoryStatus *status, void *closure) {
+    *status = *(GCMemoryStatus *) closure;
+    return true;
+}
+
+//source == NULL selects GCCgroupMemorySource; watermarks and interval can be tuned through gCollector->pressure.
+void GCEnablePressureMode(GCollector *gCollector, GCMemorySource source, void *closure) {
+    GCPressureConfig *pressure = &gCollector->pressure;
+    pressure->enabled = true;
+    pressure->earlyWatermark = 0.2;
+    pressure->emergencyWatermark = 0.05;
+    pressure->checkInterval = 1 << 20;
+    pressure->bytesSinceCheck = 0;
+    pressure->source = source != NULL ? source : GCCgroupMemorySource;
+    pressure->sourceClosure = closure;
+}
+
+void GCDisablePressureMode(GCollector *gCollector) {
+    gCollector->pressure.enabled = false;
+}
+
+//Returns true if a collection was run.
+bool GCCheckMemoryPressure(GCollector *gCollector, size_t size) {
+    GCPressureConfig *pressure = &gCollector->pressure;
+    if (!pressure->enabled)
+        return false;
+    pressure->bytesSinceCheck += size;
+    if (pressure->bytesSinceCheck < pressure->checkInterval)
+        return false;
+    pressure->bytesSinceCheck = 0;
+
+    GCMemoryStatus status;
+    if (!pressure->source(&status, pressure->sourceClosure) || status.limit <= 0)
+        return false;
+    int64 usage = status.current > status.rss ? status.current : status.rss;
+    double headroom = (double) (status.limit - usage) / (double) status.limit;
+    if (headroom >= pressure->earlyWatermark)
+        return false;
+    GCRun(gCollector);
+    if (headroom < pressure->emergencyWatermark) {
+#ifdef __GLIBC__
+        malloc_trim(0);
+#endif
+        pressure->emergencyCollections += 1;
+    } else {
+        pressure->earlyCollections += 1;
+    }
+    return true;
+}
+
+void RecordPause(GCPauseHistory *history, uint64 pauseTime) {
+    history->samples[history->head] = pauseTime;
+    history->head = (history->head + 1) % GC_PAUSE_WINDOW;
+    if (history->count < GC_PAUSE_WINDOW)
+        history->count += 1;
+}
+
+int CompareUInt64(const void *a, const void *b) {
+    uint64 x = *(const uint64 *) a, y = *(const uint64 *) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+GCPauseSummary GCGetPauseSummary(GCollector *gCollector) {
+    GCPauseHistory *history = &gCollector->pauseHistory;
+    GCPauseSummary summary = {history->count, 0, 0, 0};
+    if (history->count == 0)
+        return summary;
+    uint64 sorted[GC_PAUSE_WINDOW];
+    MemoryCopy(history->samples, sorted, history->count * sizeof(uint64));
+    qsort(sorted, history->count, sizeof(uint64), CompareUInt64);
+    //Nearest-rank percentiles.
+    summary.p50 = sorted[(history->count * 50 + 99) / 100 - 1];
+    summary.p99 = sorted[(history->count * 99 + 99) / 100 - 1];
+    summary.max = sorted[history->count - 1];
+    return summary;
+}
+
+//Bucket i counts pauses in (2^(i-1), 2^i] microseconds, bucket 0 counts pauses of at most 1us.
+int PauseBucket(uint64 pauseTime) {
+    int bucket = 0;
+    while (bucket < GC_PAUSE_BUCKETS - 1 && ((uint64) 1 << bucket) < pauseTime)
+        bucket++;
+    return bucket;
+}
+
+void GCExportPauseHistogram(GCollector *gCollector, FILE *file, GCExportFormat format) {
+    GCPauseHistory *history = &gCollector->pauseHistory;
+    GCPauseSummary summary = GCGetPauseSummary(gCollector);
+    int buckets[GC_PAUSE_BUCKETS] = {0};
+    int lastBucket = 0;
+    for (int i = 0; i < history->count; ++i) {
+        int bucket = PauseBucket(history->samples[i]);
+        buckets[bucket] += 1;
+        if (bucket > lastBucket)
+            lastBucket = bucket;
+    }
+    if (format == GC_EXPORT_CSV) {
+        fprintf(file, "stat,value\n");
+        fprintf(file, "count,%d\n", summary.count);
+        fprintf(file, "p50_us,%llu\n", summary.p50);
+        fprintf(file, "p99_us,%llu\n", summary.p99);
+        fprintf(file, "max_us,%llu\n", summary.max);
+        for (int i = 0; i <= lastBucket; ++i)
+            fprintf(file, "le_%lluus,%d\n", (uint64) 1 << i, buckets[i]);
+    } else {
+        fprintf(file, "{\"count\":%d,\"p50_us\":%llu,\"p99_us\":%llu,\"max_us\":%llu,\"buckets\":[",
+                summary.count, summary.p50, summary.p99, summary.max);
+        for (int i = 0; i <= lastBucket; ++i)
+            fprintf(file, "%s{\"le_us\":%llu,\"count\":%d}", i ? "," : "", (uint64) 1 << i, buckets[i]);
+        fprintf(file, "]}\n");
+    }
+}
+
+void OutputGCInfo(GCollector *gCollector) {
+    printf("GC Summary:\n");
+    printf("\t Minimal Address: [%p] Maximal Address: [%p]\n", gCollector->minAddr, gCollector->maxAddr);
+    printf("\t Memory sections count: %d \t Total memory allocated: %d bytes\n", gCollector->sectionCount,
+           gCollector->byteCount);
+    if (gCollector->pressure.enabled)
+        printf("\t Pressure collections: %d early, %d emergency\n", gCollector->pressure.earlyCollections,
+               gCollector->pressure.emergencyCollections);
+    if (gCollector->nursery.enabled)
+        printf("\t Nursery: %d chunks, %d bytes in use \t Minor collections: %d\n", gCollector->nursery.chunkCount,
+               gCollector->nursery.usedBytes, gCollector->nursery.minorCollections);
+    GCCycleStats *stats = &gCollector->cycleStats;
+    if (stats->cycle == 0)
+        return;
+    printf("\t Last %s cycle #%llu: root scan %llu us, mark %llu us, sweep %llu us, pause %llu us\n",
+           stats->minor ? "minor" : "major", stats->cycle,
+           stats->rootScanTime, stats->markTime, stats->sweepTime, stats->pauseTime);
+    printf("\t Scanned %lld objects (%lld bytes), marked %lld objects (%lld bytes)\n", stats->objectsScanned,
+           stats->bytesScanned, stats->objectsMarked, stats->bytesMarked);
+    printf("\t Reclaimed %lld objects (%lld bytes)\n", stats->objectsReclaimed, stats->bytesReclaimed);
+    printf("\t Candidate pointers examined: %lld \t Heap: %lld -> %lld bytes\n", stats->candidatesExamined,
+           stats->heapBytesBefore, stats->heapBytesAfter);
+    GCPauseSummary summary = GCGetPauseSummary(gCollector);
+    printf("\t Pauses over last %d cycles: p50 %llu us, p99 %llu us, max %llu us\n", summary.count, summary.p50,
+           summary.p99, summary.max);
+}
+
+void *StackBottom() {
+    int x = 1;
+    //Read back through a volatile so optimizing compilers do not replace the escaping local address with NULL.
+    int *volatile ptr = &x + 0;
+    return ptr;
+}
+
+void *GetStackBottom(void) {
+    jmp_buf env;
+    setjmp(env);
+    void *(*volatile f)(void) = StackBottom;
+    return f();
+}
+
+struct ScanHeapClosure {
+    void *minAddr, *maxAddr;
+    RecordMap *possibleRefs;
+    GCCycleStats *stats;
+};
+
+struct ScanRootClosure {
+    void *minAddr, *maxAddr;
+    RecordMap *possibleRefs;
+    GCCycleStats *stats;
+};
+
+struct MarkClosure {
+    RecordMap *possibleRefs;
+    GCCycleStats *stats;
+};
+
+
+void ScanHeapTraverser(RecordEntry *record, void *closure) {
+    struct ScanHeapClosure *sClosure = (struct ScanHeapClosure *) closure;
+    if (record->mallocSize < 8)
+        return;
+    sClosure->stats->objectsScanned += 1;
+    sClosure->stats->bytesScanned += record->mallocSize;
+    char *endAddr = (char *) record->mallocAddr + record->mallocSize;
+    for (void **current = record->mallocAddr; (char *) current < endAddr; current++) {
+        void *ref = *current;
+        sClosure->stats->candidatesExamined += 1;
+        if (ref < sClosure->minAddr || ref > sClosure->maxAddr)
+            continue;
+        RecordEntry entry = {ref, 0, 0, 0};
+        AddRecord(sClosure->possibleRefs, &entry, false);
+    }
+}
+
+void ScanRootTraverser(RecordEntry *root, void *closure) {
+    struct ScanRootClosure *rClosure = (struct ScanRootClosure *) closure;
+    char *endAddr = (char *) root->mallocAddr + root->mallocSize;
+    for (void **current = root->mallocAddr; (char *) (current + 1) <= endAddr; current++) {
+        void *ref = *current;
+        rClosure->stats->candidatesExamined += 1;
+        if (ref < rClosure->minAddr || ref > rClosure->maxAddr)
+            continue;
+        RecordEntry entry = {ref, 0, 0, 0};
+        AddRecord(rClosure->possibleRefs, &entry, false);
+    }
+}
+
+void ReferencedMarkTraverser(RecordEntry *record, void *closure) {
+    //printf("Check mark for: %p\n", record->mallocAddr);
+    struct MarkClosure *mClosure = (struct MarkClosure *) closure;
+    if (GetRecord(mClosure->possibleRefs, record->mallocAddr) != NULL) {
+        record->isInUse = true;
+        mClosure->stats->objectsMarked += 1;
+        mClosure->stats->bytesMarked += record->mallocSize;
+        //printf("%p is in use\n", record->mallocAddr);
+    } else {
+        record->isInUse = false;
+    }
+}
+
+void GCMark(GCollector *gCollector, GCCycleStats *stats) {
+    uint64 startTime = GetTimeMicroSeconds();
+    jmp_buf registers;
+    SPILL_REGISTERS(registers);
+    void **stackTop = gCollector->FrameTop;
+    void **stackBot = GetStackBottom();
+    RecordMap possibleRefs;
+    InitRecordMap(&possibleRefs);
+    for (void **current = stackTop; current > stackBot; current--) {
+        void *ref = *current;
+        stats->candidatesExamined += 1;
+        if (ref < gCollector->minAddr || ref > gCollector->maxAddr)
+            continue;
+        RecordEntry entry = {ref, 0, 0, 0};
+        AddRecord(&possibleRefs, &entry, false);
+        //printf("Found [%p] @ [%p]\n", ref, current);
+    }
+    struct ScanRootClosure rootClosure = {gCollector->minAddr, gCollector->maxAddr, &possibleRefs, stats};
+    TraverseRecordMap(&gCollector->roots, ScanRootTraverser, &rootClosure);
+    uint64 rootScanEndTime = GetTimeMicroSeconds();
+    struct ScanHeapClosure closure = {gCollector->minAddr, gCollector->maxAddr, &possibleRefs, stats};
+    TraverseRecordMap(&gCollector->records, ScanHeapTraverser, &closure);
+    struct MarkClosure markClosure = {&possibleRefs, stats};
+    TraverseRecordMap(&gCollector->records, ReferencedMarkTraverser, &markClosure);
+    FreeRecordMap(&possibleRefs);
+    stats->rootScanTime = rootScanEndTime - startTime;
+    stats->markTime = GetTimeMicroSeconds() - rootScanEndTime;
+}
+
+void ReleaseRecord(GCollector *gCollector, RecordEntry *entry);
+
+//Sweeps bucket by bucket instead of through TraverseRecordMap, which cannot cope with entries being removed under
+//it: unmarked chained entries are unlinked first, then unmarked heads are replaced by their successors.
+void GCSweep(GCollector *gCollector) {
+    uint64 startTime = GetTimeMicroSeconds();
+    GCCycleStats *stats = &gCollector->cycleStats;
+    RecordMap *map = &gCollector->records;
+    for (int i = 0; i < map->capacity; ++i) {
+        RecordEntry *head = map->entries + i;
+        if (head->mallocAddr == NULL)
+            continue;
+        RecordEntry *previous = head;
+        while (previous->next != NULL) {
+            RecordEntry *current = previous->next;
+            if (current->isInUse) {
+                previous = current;
+                continue;
+            }
+            stats->objectsReclaimed += 1;
+            stats->bytesReclaimed += current->mallocSize;
+            ReleaseRecord(gCollector, current);
+            previous->next = current->next;
+            free(current);
+            map->size -= 1;
+        }
+        if (!head->isInUse) {
+            stats->objectsReclaimed += 1;
+            stats->bytesReclaimed += head->mallocSize;
+            ReleaseRecord(gCollector, head);
+            if (head->next != NULL) {
+                RecordEntry *next = head->next;
+                *head = *next;
+                free(next);
+            } else {
+                head->mallocAddr = NULL;
+            }
+            map->size -= 1;
+        }
+        for (RecordEntry *current = head; current != NULL && current->mallocAddr != NULL; current = current->next)
+            current->isInUse = false;
+    }
+    stats->sweepTime = GetTimeMicroSeconds() - startTime;
+}
+
+//Resets the cycle statistics and returns the start time of the cycle.
+uint64 BeginCycle(GCollector *gCollector, bool minor) {
+    GCCycleStats *stats = &gCollector->cycleStats;
+    uint64 cycle = stats->cycle + 1;
+    MemoryClear(stats, sizeof(GCCycleStats));
+    stats->cycle = cycle;
+    stats->minor = minor;
+    stats->heapBytesBefore = gCollector->byteCount + gCollector->nursery.usedBytes;
+    return GetTimeMicroSeconds();
+}
+
+void EndCycle(GCollector *gCollector, uint64 startTime) {
+    GCCycleStats *stats = &gCollector->cycleStats;
+    stats->pauseTime = GetTimeMicroSeconds() - startTime;
+    stats->heapBytesAfter = gCollector->byteCount + gCollector->nursery.usedBytes;
+    RecordPause(&gCollector->pauseHistory, stats->pauseTime);
+    if (gCollector->cycleCallback != NULL)
+        gCollector->cycleCallback(stats, gCollector->cycleClosure);
+}
+
+//In generational mode the nursery is emptied first, so the major collection only deals with records.
+void GCRun(GCollector *gCollector) {
+    if (gCollector->nursery.enabled)
+        GCMinorCollect(gCollector);
+    uint64 startTime = BeginCycle(gCollector, false);
+    GCMark(gCollector, &gCollector->cycleStats);
+    GCSweep(gCollector);
+    EndCycle(gCollector, startTime);
+}
+
+struct DumpClosure {
+    GCollector *gCollector;
+    FILE *file;
+    uint64 edgeCount, rootCount;
+    GCRootOrigin origin;
+};
+
+void WriteDumpEntry(FILE *file, uint32 tag, uint32 flags, uint64 a, uint64 b, uint64 c) {
+    GCDumpEntry entry = {tag, flags, a, b, c};
+    fwrite(&entry, sizeof(GCDumpEntry), 1, file);
+}
+
+//Emits a ROOT entry if the slot points at the start of a record.
+void DumpRootSlot(struct DumpClosure *dClosure, void **slot) {
+    GCollector *gCollector = dClosure->gCollector;
+    void *ref = *slot;
+    if (ref < gCollector->minAddr || ref > gCollector->maxAddr)
+        return;
+    if (GetRecord(&gCollector->records, ref) == NULL)
+        return;
+    WriteDumpEntry(dClosure->file, GC_DUMP_ROOT, dClosure->origin, (uint64) slot, (uint64) ref, 0);
+    dClosure->rootCount += 1;
+}
+
+void DumpRootTraverser(RecordEntry *root, void *closure) {
+    char *endAddr = (char *) root->mallocAddr + root->mallocSize;
+    for (void **current = root->mallocAddr; (char *) (current + 1) <= endAddr; current++)
+        DumpRootSlot((struct DumpClosure *) closure, current);
+}
+
+void DumpRecordTraverser(RecordEntry *record, void *closure) {
+    struct DumpClosure *dClosure = (struct DumpClosure *) closure;
+    GCollector *gCollector = dClosure->gCollector;
+    WriteDumpEntry(dClosure->file, GC_DUMP_RECORD, 0, (uint64) record->mallocAddr, (uint64) record->mallocSize, 0);
+    char *endAddr = (char *) record->mallocAddr + record->mallocSize;
+    for (void **current = record->mallocAddr; (char *) (current + 1) <= endAddr; current++) {
+        void *ref = *current;
+        if (ref < gCollector->minAddr || ref > gCollector->maxAddr)
+            continue;
+        if (GetRecord(&gCollector->records, ref) == NULL)
+            continue;
+        WriteDumpEntry(dClosure->file, GC_DUMP_EDGE, 0, (uint64) record->mallocAddr, (uint64) ref,
+                       (uint64) ((char *) current - (char *) record->mallocAddr));
+        dClosure->edgeCount += 1;
+    }
+}
+
+//Writes a snapshot of the heap to path in the format described in gcDump.h, see heapAnalyzer.c for a reader.
+//Entries are streamed straight from the record map without marking, the edges and roots in the dump are enough
+//to tell offline what the next collection would keep.
+bool GCDumpHeap(GCollector *gCollector, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+    if (gCollector->nursery.enabled)
+        GCMinorCollect(gCollector);
+    jmp_buf registers;
+    SPILL_REGISTERS(registers);
+
+    struct DumpClosure closure = {gCollector, file, 0, 0, GC_ROOT_STACK};
+    WriteDumpEntry(file, GC_DUMP_HEADER, GC_DUMP_VERSION, GC_DUMP_MAGIC, (uint64) gCollector->sectionCount, 0);
+    TraverseRecordMap(&gCollector->records, DumpRecordTraverser, &closure);
+    void **stackTop = gCollector->FrameTop;
+    void **stackBot = GetStackBottom();
+    for (void **current = stackTop; current > stackBot; current--)
+        DumpRootSlot(&closure, current);
+    closure.origin = GC_ROOT_REGISTERED;
+    TraverseRecordMap(&gCollector->roots, DumpRootTraverser, &closure);
+    WriteDumpEntry(file, GC_DUMP_END, 0, closure.edgeCount, closure.rootCount, 0);
+
+    bool succeeded = !ferror(file);
+    return fclose(file) == 0 && succeeded;
+}
+
+void TrackRecord(GCollector *gCollector, void *ptr, size_t size) {
+    RecordEntry record = {ptr, size, false, 0};
+    AddRecord(&gCollector->records, &record, false);
+    if (ptr < gCollector->minAddr || gCollector->minAddr == 0)
+        gCollector->minAddr = ptr;
+    if (ptr > gCollector->maxAddr || gCollector->maxAddr == 0)
+        gCollector->maxAddr = ptr;
+    gCollector->sectionCount += 1;
+    gCollector->byteCount += size;
+}
+
+void *NurseryMalloc(GCollector *gCollector, size_t size);
+
+void *GCMalloc(GCollector *gCollector, size_t size) {
+    //A nursery that lost all of its chunks to failed allocations falls back to records.
+    if (gCollector->nursery.enabled && gCollector->nursery.chunkCount > 0 && size <= GC_NURSERY_MAX_OBJECT) {
+        void *ptr = NurseryMalloc(gCollector, size);
+        if (ptr != NULL)
+            return ptr;
+    }
+    if (!GCCheckMemoryPressure(gCollector, size) && gCollector->byteCount > gCollector->collectThreshold)
+        GCRun(gCollector);
+    void *ptr = malloc(size);
+    if (ptr == NULL)
+        return NULL;
+    TrackRecord(gCollector, ptr, size);
+    return ptr;
+}
+
+bool ReleaseNurseryObject(GCollector *gCollector, void *ptr);
+bool FreeYoungObject(GCollector *gCollector, void *ptr);
+bool ForgetDirtyCards(GCollector *gCollector, void *ptr, size_t size);
+
+//Frees the memory of a record and updates the bookkeeping, the entry itself stays in the map.
+void ReleaseRecord(GCollector *gCollector, RecordEntry *entry) {
+    void *ptr = entry->mallocAddr;
+    if (ptr == gCollector->minAddr)
+        gCollector->minAddr += entry->mallocSize;
+    if (ptr == gCollector->maxAddr)
+        gCollector->maxAddr -= 1;
+    gCollector->sectionCount -= 1;
+    gCollector->byteCount -= entry->mallocSize;
+    if (!ReleaseNurseryObject(gCollector, ptr))
+        free(ptr);
+}
+
+void GCFree(GCollector *gCollector, void *ptr) {
+    if (ptr == NULL)
+        return;
+    if (FreeYoungObject(gCollector, ptr))
+        return;
+    RecordEntry *entry = GetRecord(&gCollector->records, ptr);
+    if (entry == NULL)
+        return;
+    printf("Free %d bytes @ [%p]\n", entry->mallocSize, entry->mallocAddr);
+    //Dirty cards covering the object have to be gone before its memory is. Survivors promoted by the minor
+    //collection may expand the record map, so the entry is looked up again.
+    if (!ForgetDirtyCards(gCollector, ptr, entry->mallocSize)) {
+        GCMinorCollect(gCollector);
+        entry = GetRecord(&gCollector->records, ptr);
+    }
+    ReleaseRecord(gCollector, entry);
+    RemoveRecord(&gCollector->records, ptr);
+}
+
+//Generational mode, see GCNursery. Every chunk starts with a NurseryChunk header followed by objects, each object
+//is a 16 byte size header and its payload rounded up to 16 bytes. Payload starts are flagged in a bitmap so
+//conservative candidates can be checked exactly.
+
+#define GC_GRANULE 16
+#define GC_CHUNK_GRANULES (GC_CHUNK_SIZE / GC_GRANULE)
+
+typedef struct {
+    int top, liveCount;
+    bool retired;
+    uint8 starts[GC_CHUNK_GRANULES / 8];
+    uint8 marks[GC_CHUNK_GRANULES / 8];
+} NurseryChunk;
+
+#define GC_CHUNK_HEADER ((int) ((sizeof(NurseryChunk) + GC_GRANULE - 1) & ~(size_t) (GC_GRANULE - 1)))
+
+//Size header plus payload, an empty payload still takes a granule so no object is smaller than two granules.
+int ObjectFootprint(uint64 size) {
+    uint64 payload = (size + GC_GRANULE - 1) & ~(uint64) (GC_GRANULE - 1);
+    return GC_GRANULE + (payload > 0 ? (int) payload : GC_GRANULE);
+}
+
+NurseryChunk *AllocateChunk(GCNursery *nursery) {
+    void *memory;
+    if (posix_memalign(&memory, GC_CHUNK_SIZE, GC_CHUNK_SIZE) != 0)
+        return NULL;
+    NurseryChunk *chunk = (NurseryChunk *) memory;
+    MemoryClear(chunk, sizeof(NurseryChunk));
+    chunk->top = GC_CHUNK_HEADER;
+    RecordEntry entry = {chunk, GC_CHUNK_SIZE, false, 0};
+    AddRecord(&nursery->chunkMap, &entry, false);
+    if (nursery->minAddr == NULL || memory < nursery->minAddr)
+        nursery->minAddr = memory;
+    if ((char *) memory + GC_CHUNK_SIZE > (char *) nursery->maxAddr)
+        nursery->maxAddr = (char *) memory + GC_CHUNK_SIZE;
+    return chunk;
+}
+
+//Returns the chunk, active or retired, containing addr.
+NurseryChunk *FindChunk(GCNursery *nursery, void *addr) {
+    if (addr < nursery->minAddr || addr >= nursery->maxAddr)
+        return NULL;
+    void *base = (void *) ((uint64) addr & ~(uint64) (GC_CHUNK_SIZE - 1));
+    return GetRecord(&nursery->chunkMap, base) != NULL ? (NurseryChunk *) base : NULL;
+}
+
+bool IsYoung(GCNursery *nursery, void *addr) {
+    NurseryChunk *chunk = FindChunk(nursery, addr);
+    if (chunk == NULL || chunk->retired)
+        return false;
+    int offset = (int) ((char *) addr - (char *) chunk);
+    return offset >= GC_CHUNK_HEADER && offset < chunk->top;
+}
+
+bool GCEnableGenerational(GCollector *gCollector, int nurseryBytes) {
+    GCNursery *nursery = &gCollector->nursery;
+    if (nursery->enabled)
+        return true;
+    int chunkCount = nurseryBytes / GC_CHUNK_SIZE > 0 ? nurseryBytes / GC_CHUNK_SIZE : 1;
+    nursery->chunks = malloc(chunkCount * sizeof(void *));
+    //Every object takes at least two granules, so this bounds the number of objects marked in one minor collection.
+    nursery->worklist = malloc((size_t) chunkCount * (GC_CHUNK_GRANULES / 2) * sizeof(void *));
+    if (nursery->chunks == NULL || nursery->worklist == NULL) {
+        free(nursery->chunks);
+        free(nursery->worklist);
+        return false;
+    }
+    InitRecordMap(&nursery->chunkMap);
+    InitRecordMap(&nursery->dirtyCards);
+    nursery->minAddr = NULL;
+    nursery->maxAddr = NULL;
+    nursery->chunkCount = 0;
+    for (int i = 0; i < chunkCount; ++i) {
+        NurseryChunk *chunk = AllocateChunk(nursery);
+        if (chunk == NULL)
+            break;
+        nursery->chunks[nursery->chunkCount++] = chunk;
+    }
+    nursery->currentChunk = 0;
+    nursery->usedBytes = 0;
+    nursery->minorCollections = 0;
+    nursery->enabled = nursery->chunkCount > 0;
+    if (!nursery->enabled) {
+        FreeRecordMap(&nursery->chunkMap);
+        FreeRecordMap(&nursery->dirtyCards);
+        free(nursery->chunks);
+        free(nursery->worklist);
+    }
+    return nursery->enabled;
+}
+
+void *BumpAllocate(GCNursery *nursery, size_t size) {
+    int footprint = ObjectFootprint(size);
+    while (nursery->currentChunk < nursery->chunkCount) {
+        NurseryChunk *chunk = nursery->chunks[nursery->currentChunk];
+        if (chunk->top + footprint <= GC_CHUNK_SIZE) {
+            char *header = (char *) chunk + chunk->top;
+            *(uint64 *) header = size;
+            int granule = chunk->top / GC_GRANULE + 1;
+            chunk->starts[granule >> 3] |= (uint8) (1 << (granule & 7));
+            chunk->top += footprint;
+            nursery->usedBytes += footprint;
+            return header + GC_GRANULE;
+        }
+        nursery->currentChunk++;
+    }
+    return NULL;
+}
+
+void *NurseryMalloc(GCollector *gCollector, size_t size) {
+    GCCheckMemoryPressure(gCollector, size);
+    void *ptr = BumpAllocate(&gCollector->nursery, size);
+    if (ptr != NULL)
+        return ptr;
+    GCMinorCollect(gCollector);
+    if (gCollector->byteCount > gCollector->collectThreshold)
+        GCRun(gCollector);
+    return BumpAllocate(&gCollector->nursery, size);
+}
+
+//Stores value into slot, remembering the card of slot when an old object starts pointing at a young one.
+void GCWriteBarrier(GCollector *gCollector, void *slot, void *value) {
+    *(void **) slot = value;
+    GCNursery *nursery = &gCollector->nursery;
+    if (!nursery->enabled || !IsYoung(nursery, value) || IsYoung(nursery, slot))
+        return;
+    RecordEntry card = {(void *) ((uint64) slot & ~(uint64) (GC_CARD_SIZE - 1)), GC_CARD_SIZE, false, 0};
+    AddRecord(&nursery->dirtyCards, &card, false);
+}
+
+struct MinorClosure {
+    GCNursery *nursery;
+    void **worklist;
+    int worklistSize;
+    GCCycleStats *stats;
+};
+
+void MarkYoungCandidate(struct MinorClosure *mClosure, void *ref) {
+    mClosure->stats->candidatesExamined += 1;
+    NurseryChunk *chunk = FindChunk(mClosure->nursery, ref);
+    if (chunk == NULL || chunk->retired)
+        return;
+    int offset = (int) ((char *) ref - (char *) chunk);
+    if (offset % GC_GRANULE != 0 || offset < GC_CHUNK_HEADER || offset >= chunk->top)
+        return;
+    int granule = offset / GC_GRANULE;
+    uint8 bit = (uint8) (1 << (granule & 7));
+    if (!(chunk->starts[granule >> 3] & bit) || (chunk->marks[granule >> 3] & bit))
+        return;
+    chunk->marks[granule >> 3] |= bit;
+    mClosure->worklist[mClosure->worklistSize++] = ref;
+}
+
+void ScanYoungRange(struct MinorClosure *mClosure, void *begin, void *end) {
+    for (void **current = begin; (char *) (current + 1) <= (char *) end; current++)
+        MarkYoungCandidate(mClosure, *current);
+}
+
+void ScanYoungRootTraverser(RecordEntry *root, void *closure) {
+    ScanYoungRange((struct MinorClosure *) closure, root->mallocAddr, (char *) root->mallocAddr + root->mallocSize);
+}
+
+//Either resets a chunk without survivors or promotes its survivors to records and retires it.
+bool SweepChunk(GCollector *gCollector, NurseryChunk *chunk) {
+    GCCycleStats *stats = &gCollector->cycleStats;
+    int survivors = 0;
+    for (int offset = GC_CHUNK_HEADER; offset < chunk->top;) {
+        uint64 size = *(uint64 *) ((char *) chunk + offset);
+        int granule = offset / GC_GRANULE + 1;
+        if (chunk->marks[granule >> 3] & (1 << (granule & 7))) {
+            TrackRecord(gCollector, (char *) chunk + offset + GC_GRANULE, size);
+            stats->objectsMarked += 1;
+            stats->bytesMarked += size;
+            survivors++;
+        } else {
+            stats->objectsReclaimed += 1;
+            stats->bytesReclaimed += size;
+        }
+        offset += ObjectFootprint(size);
+    }
+    if (survivors > 0) {
+        chunk->retired = true;
+        chunk->liveCount = survivors;
+        return true;
+    }
+    chunk->top = GC_CHUNK_HEADER;
+    MemoryClear(chunk->starts, sizeof(chunk->starts));
+    MemoryClear(chunk->marks, sizeof(chunk->marks));
+    return false;
+}
+
+void GCMinorCollect(GCollector *gCollector) {
+    GCNursery *nursery = &gCollector->nursery;
+    if (!nursery->enabled)
+        return;
+    if (nursery->usedBytes == 0) {
+        FreeRecordMap(&nursery->dirtyCards);
+        InitRecordMap(&nursery->dirtyCards);
+        return;
+    }
+    uint64 startTime = BeginCycle(gCollector, true);
+    GCCycleStats *stats = &gCollector->cycleStats;
+    jmp_buf registers;
+    SPILL_REGISTERS(registers);
+    struct MinorClosure closure = {nursery, nursery->worklist, 0, stats};
+    void **stackTop = gCollector->FrameTop;
+    void **stackBot = GetStackBottom();
+    for (void **current = stackTop; current > stackBot; current--)
+        MarkYoungCandidate(&closure, *current);
+    TraverseRecordMap(&gCollector->roots, ScanYoungRootTraverser, &closure);
+    TraverseRecordMap(&nursery->dirtyCards, ScanYoungRootTraverser, &closure);
+    uint64 rootScanEndTime = GetTimeMicroSeconds();
+
+    while (closure.worklistSize > 0) {
+        char *object = closure.worklist[--closure.worklistSize];
+        uint64 size = *(uint64 *) (object - GC_GRANULE);
+        stats->objectsScanned += 1;
+        stats->bytesScanned += size;
+        ScanYoungRange(&closure, object, object + size);
+    }
+    uint64 markEndTime = GetTimeMicroSeconds();
+
+    int usedChunks = nursery->currentChunk < nursery->chunkCount ? nursery->currentChunk + 1 : nursery->chunkCount;
+    for (int i = 0; i < usedChunks; ++i) {
+        if (!SweepChunk(gCollector, nursery->chunks[i]))
+            continue;
+        NurseryChunk *fresh = AllocateChunk(nursery);
+        if (fresh != NULL) {
+            nursery->chunks[i] = fresh;
+        } else {
+            //Out of memory, the nursery shrinks by one chunk.
+            nursery->chunks[i] = nursery->chunks[--nursery->chunkCount];
+            usedChunks = usedChunks < nursery->chunkCount ? usedChunks : nursery->chunkCount;
+            i--;
+        }
+    }
+    FreeRecordMap(&nursery->dirtyCards);
+    InitRecordMap(&nursery->dirtyCards);
+    nursery->currentChunk = 0;
+    nursery->usedBytes = 0;
+    nursery->minorCollections += 1;
+
+    stats->rootScanTime = rootScanEndTime - startTime;
+    stats->markTime = markEndTime - rootScanEndTime;
+    stats->sweepTime = GetTimeMicroSeconds() - markEndTime;
+    EndCycle(gCollector, startTime);
+}
+
+//A young object cannot be given back before the next minor collection, clearing its start bit makes sure that
+//collection neither marks nor promotes it. Returns false if ptr is not the start of a young object.
+bool FreeYoungObject(GCollector *gCollector, void *ptr) {
+    GCNursery *nursery = &gCollector->nursery;
+    if (!nursery->enabled || !IsYoung(nursery, ptr))
+        return false;
+    NurseryChunk *chunk = FindChunk(nursery, ptr);
+    int offset = (int) ((char *) ptr - (char *) chunk);
+    int granule = offset / GC_GRANULE;
+    uint8 bit = (uint8) (1 << (granule & 7));
+    if (offset % GC_GRANULE != 0 || !(chunk->starts[granule >> 3] & bit))
+        return false;
+    chunk->starts[granule >> 3] &= (uint8) ~bit;
+    return true;
+}
+
+bool HasYoungCandidate(GCNursery *nursery, void *begin, void *end) {
+    begin = (void *) (((uint64) begin + sizeof(void *) - 1) & ~(uint64) (sizeof(void *) - 1));
+    for (void **current = begin; (char *) (current + 1) <= (char *) end; current++)
+        if (IsYoung(nursery, *current))
+            return true;
+    return false;
+}
+
+//Removes the dirty cards overlapping [ptr, ptr + size) of an old object about to be released. A card sticking out
+//of the object may remember a young pointer of a neighbour, then false is returned and the caller has to run a
+//minor collection instead.
+bool ForgetDirtyCards(GCollector *gCollector, void *ptr, size_t size) {
+    GCNursery *nursery = &gCollector->nursery;
+    if (!nursery->enabled || nursery->dirtyCards.size == 0)
+        return true;
+    char *begin = ptr, *end = begin + size;
+    char *card = (char *) ((uint64) begin & ~(uint64) (GC_CARD_SIZE - 1));
+    for (; card < end && nursery->dirtyCards.size > 0; card += GC_CARD_SIZE) {
+        if (GetRecord(&nursery->dirtyCards, card) == NULL)
+            continue;
+        if (card < begin && HasYoungCandidate(nursery, card, begin))
+            return false;
+        if (card + GC_CARD_SIZE > end && HasYoungCandidate(nursery, end, card + GC_CARD_SIZE))
+            return false;
+        RemoveRecord(&nursery->dirtyCards, card);
+    }
+    return true;
+}
+
+//Called for every released record, returns true if ptr lived in a retired chunk instead of its own malloc block.
+bool ReleaseNurseryObject(GCollector *gCollector, void *ptr) {
+    GCNursery *nursery = &gCollector->nursery;
+    if (!nursery->enabled)
+        return false;
+    NurseryChunk *chunk = FindChunk(nursery, ptr);
+    if (chunk == NULL)
+        return false;
+    chunk->liveCount -= 1;
+    if (chunk->liveCount == 0) {
+        RemoveRecord(&nursery->chunkMap, chunk);
+        free(chunk);
+    }
+    return true;
+}
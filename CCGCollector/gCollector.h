@@ -0,0 +1,134 @@
+#ifndef INC_G_COLLECTOR
+#define INC_G_COLLECTOR
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ccCommon.h"
+
+typedef struct MRE_ {
+    void *mallocAddr;
+    int mallocSize;
+    bool isInUse;
+    struct MRE_ *next;
+} RecordEntry;
+
+typedef struct {
+    RecordEntry *entries;
+    int size, capacity;
+    double loadFactor;
+} RecordMap;
+
+//All durations are in microseconds, measured with GetTimeMicroSeconds.
+typedef struct {
+    uint64 cycle;
+    bool minor;
+    uint64 rootScanTime, markTime, sweepTime, pauseTime;
+    int64 objectsScanned, bytesScanned;
+    int64 objectsMarked, bytesMarked;
+    int64 objectsReclaimed, bytesReclaimed;
+    int64 candidatesExamined;
+    int64 heapBytesBefore, heapBytesAfter;
+} GCCycleStats;
+
+#define GC_PAUSE_WINDOW 1024
+#define GC_PAUSE_BUCKETS 32
+
+//Ring buffer holding the pause times of the last GC_PAUSE_WINDOW cycles.
+typedef struct {
+    uint64 samples[GC_PAUSE_WINDOW];
+    int head, count;
+} GCPauseHistory;
+
+typedef struct {
+    int count;
+    uint64 p50, p99, max;
+} GCPauseSummary;
+
+typedef enum {
+    GC_EXPORT_CSV,
+    GC_EXPORT_JSON
+} GCExportFormat;
+
+typedef void (*GCCycleCallback)(const GCCycleStats *stats, void *closure);
+
+//All sizes are in bytes, -1 means unknown or unlimited.
+typedef struct {
+    int64 limit, current, rss;
+} GCMemoryStatus;
+
+typedef bool (*GCMemorySource)(GCMemoryStatus *status, void *closure);
+
+//Headroom is (limit - usage) / limit, usage being the larger of current and rss.
+//Below earlyWatermark a collection runs ahead of collectThreshold, below emergencyWatermark free chunks are also
+//returned to the system. The source is polled once every checkInterval bytes allocated.
+typedef struct {
+    bool enabled;
+    double earlyWatermark, emergencyWatermark;
+    size_t checkInterval, bytesSinceCheck;
+    GCMemorySource source;
+    void *sourceClosure;
+    int earlyCollections, emergencyCollections;
+} GCPressureConfig;
+
+#define GC_CHUNK_SIZE (64 << 10)
+#define GC_CARD_SIZE 512
+#define GC_NURSERY_MAX_OBJECT (4 << 10)
+
+//Generational mode: objects of at most GC_NURSERY_MAX_OBJECT bytes are bump-allocated in GC_CHUNK_SIZE aligned
+//chunks. A minor collection marks young objects from the stack, the registered roots and the dirty cards; chunks
+//without survivors are reused, chunks with survivors are retired to the old space in place and replaced.
+//Stores of young pointers into old objects must go through GCWriteBarrier.
+typedef struct {
+    bool enabled;
+    int chunkCount, currentChunk;
+    void **chunks;
+    RecordMap chunkMap;
+    RecordMap dirtyCards;
+    void *minAddr, *maxAddr;
+    void **worklist;
+    int usedBytes;
+    int minorCollections;
+} GCNursery;
+
+typedef struct {
+    RecordMap records;
+    RecordMap roots;
+    void *FrameTop;
+    void *minAddr, *maxAddr;
+    int sectionCount, byteCount;
+    int collectThreshold;
+    GCCycleStats cycleStats;
+    GCPauseHistory pauseHistory;
+    GCCycleCallback cycleCallback;
+    void *cycleClosure;
+    GCPressureConfig pressure;
+    GCNursery nursery;
+} GCollector;
+
+
+void GCInit(GCollector *gCollector, void *pArgc);
+void GCEnd(GCollector *gCollector);
+void *GCMalloc(GCollector *gCollector, size_t size);
+void GCFree(GCollector *gCollector, void *ptr);
+void GCRun(GCollector *gCollector);
+
+bool GCAddRoot(GCollector *gCollector, void *addr, int size);
+bool GCRemoveRoot(GCollector *gCollector, void *addr);
+
+void GCSetCycleCallback(GCollector *gCollector, GCCycleCallback callback, void *closure);
+GCPauseSummary GCGetPauseSummary(GCollector *gCollector);
+void GCExportPauseHistogram(GCollector *gCollector, FILE *file, GCExportFormat format);
+void OutputGCInfo(GCollector *gCollector);
+
+bool GCCgroupMemorySource(GCMemoryStatus *status, void *closure);
+bool GCSimulatedMemorySource(GCMemoryStatus *status, void *closure);
+void GCEnablePressureMode(GCollector *gCollector, GCMemorySource source, void *closure);
+void GCDisablePressureMode(GCollector *gCollector);
+
+bool GCDumpHeap(GCollector *gCollector, const char *path);
+
+bool GCEnableGenerational(GCollector *gCollector, int nurseryBytes);
+void GCWriteBarrier(GCollector *gCollector, void *slot, void *value);
+void GCMinorCollect(GCollector *gCollector);
+
+#endif
@@ -0,0 +1,383 @@
+//Standard workloads run on the collector, on the collector in generational mode and on plain malloc/free, every
+//run in its own process so peak RSS is per workload.
+//Usage: gcBench [scale] [workload]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sys/resource.h"
+#include "sys/wait.h"
+#include "unistd.h"
+#include "gCollector.h"
+
+#define BENCH_BASE_THRESHOLD (4 << 20)
+#define BENCH_NURSERY_BYTES (4 << 20)
+
+typedef enum {
+    BENCH_MALLOC,
+    BENCH_GC,
+    BENCH_GC_GENERATIONAL
+} BenchMode;
+
+const char *modeNames[] = {"malloc", "gc", "gc-gen"};
+
+typedef struct {
+    bool useGC;
+    GCollector *gCollector;
+    uint64 allocCount, allocBytes;
+    uint64 gcTime, maxMajorPause, maxMinorPause;
+    int majorCycles, minorCycles;
+} BenchAllocator;
+
+typedef void (*BenchWorkload)(BenchAllocator *allocator, int scale);
+
+void *BenchMalloc(BenchAllocator *allocator, size_t size) {
+    allocator->allocCount += 1;
+    allocator->allocBytes += size;
+    void *ptr = allocator->useGC ? GCMalloc(allocator->gCollector, size) : malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+//Only the malloc baseline frees explicitly, the collector finds dropped objects by itself.
+void BenchDrop(BenchAllocator *allocator, void *ptr) {
+    if (!allocator->useGC)
+        free(ptr);
+}
+
+//Pointer stores into objects that may already be old, plain stores for malloc and the non generational collector.
+void BenchStore(BenchAllocator *allocator, void *slot, void *value) {
+    if (allocator->useGC)
+        GCWriteBarrier(allocator->gCollector, slot, value);
+    else
+        *(void **) slot = value;
+}
+
+//Accumulates pause times and lets the threshold follow the live heap so a large live set does not make every
+//allocation collect.
+void BenchCycleCallback(const GCCycleStats *stats, void *closure) {
+    BenchAllocator *allocator = (BenchAllocator *) closure;
+    allocator->gcTime += stats->pauseTime;
+    if (stats->minor) {
+        if (stats->pauseTime > allocator->maxMinorPause)
+            allocator->maxMinorPause = stats->pauseTime;
+        allocator->minorCycles += 1;
+        return;
+    }
+    if (stats->pauseTime > allocator->maxMajorPause)
+        allocator->maxMajorPause = stats->pauseTime;
+    allocator->majorCycles += 1;
+    int threshold = (int) (stats->heapBytesAfter * 2);
+    allocator->gCollector->collectThreshold = threshold > BENCH_BASE_THRESHOLD ? threshold : BENCH_BASE_THRESHOLD;
+}
+
+//GCBench: binary trees of growing depth next to a long-lived tree and array.
+
+typedef struct TreeNode_ {
+    struct TreeNode_ *left, *right;
+    int64 value;
+} TreeNode;
+
+TreeNode *MakeTree(BenchAllocator *allocator, int depth) {
+    TreeNode *node = BenchMalloc(allocator, sizeof(TreeNode));
+    node->left = NULL;
+    node->right = NULL;
+    node->value = depth;
+    //A minor collection while building the subtrees may promote node.
+    if (depth > 0) {
+        BenchStore(allocator, &node->left, MakeTree(allocator, depth - 1));
+        BenchStore(allocator, &node->right, MakeTree(allocator, depth - 1));
+    }
+    return node;
+}
+
+int64 CheckTree(TreeNode *node) {
+    if (node == NULL)
+        return 0;
+    return 1 + CheckTree(node->left) + CheckTree(node->right);
+}
+
+void DropTree(BenchAllocator *allocator, TreeNode *node) {
+    if (allocator->useGC || node == NULL)
+        return;
+    DropTree(allocator, node->left);
+    DropTree(allocator, node->right);
+    free(node);
+}
+
+void BinaryTreesWorkload(BenchAllocator *allocator, int scale) {
+    int maxDepth = 14;
+    TreeNode *longLived = MakeTree(allocator, maxDepth - 2);
+    double *array = BenchMalloc(allocator, 100000 * sizeof(double));
+    for (int i = 0; i < 100000; ++i)
+        array[i] = 1.0 / (i + 1);
+    for (int depth = 4; depth <= maxDepth; depth += 2) {
+        int iterations = scale * (1 << (maxDepth - depth + 2));
+        for (int i = 0; i < iterations; ++i) {
+            TreeNode *tree = MakeTree(allocator, depth);
+            if (CheckTree(tree) != (2LL << depth) - 1) {
+                fprintf(stderr, "Binary tree of depth %d is corrupted\n", depth);
+                exit(1);
+            }
+            DropTree(allocator, tree);
+        }
+    }
+    if (CheckTree(longLived) != (2LL << (maxDepth - 2)) - 1 || array[1000] != 1.0 / 1001) {
+        fprintf(stderr, "Long-lived data is corrupted\n");
+        exit(1);
+    }
+    DropTree(allocator, longLived);
+    BenchDrop(allocator, array);
+}
+
+//Long linked lists built, walked and dropped as a whole.
+
+typedef struct ListNode_ {
+    struct ListNode_ *next;
+    int64 value;
+} ListNode;
+
+void LinkedListWorkload(BenchAllocator *allocator, int scale) {
+    int length = 100000;
+    for (int round = 0; round < 10 * scale; ++round) {
+        ListNode *head = NULL;
+        for (int i = 0; i < length; ++i) {
+            ListNode *node = BenchMalloc(allocator, sizeof(ListNode));
+            node->next = head;
+            node->value = i;
+            head = node;
+        }
+        int64 sum = 0;
+        for (ListNode *node = head; node != NULL; node = node->next)
+            sum += node->value;
+        if (sum != (int64) length * (length - 1) / 2) {
+            fprintf(stderr, "Linked list is corrupted\n");
+            exit(1);
+        }
+        while (head != NULL) {
+            ListNode *next = head->next;
+            BenchDrop(allocator, head);
+            head = next;
+        }
+    }
+}
+
+//A random object graph: a rooted table of slots whose objects are replaced at random, new objects point at
+//random live ones.
+
+#define GRAPH_EDGES 4
+
+typedef struct GraphNode_ {
+    struct GraphNode_ *edges[GRAPH_EDGES];
+    int64 id;
+} GraphNode;
+
+void RandomGraphWorkload(BenchAllocator *allocator, int scale) {
+    int slotCount = 10000, replacements = 200000 * scale;
+    GraphNode **slots = calloc(slotCount, sizeof(GraphNode *));
+    if (allocator->useGC)
+        GCAddRoot(allocator->gCollector, slots, slotCount * (int) sizeof(GraphNode *));
+    srand(42);
+    for (int i = 0; i < slotCount + replacements; ++i) {
+        int slot = i < slotCount ? i : rand() % slotCount;
+        //Payload sizes vary so that not all objects share one size class.
+        size_t size = sizeof(GraphNode) + (size_t) (rand() % 4) * 32;
+        GraphNode *node = BenchMalloc(allocator, size);
+        node->id = i;
+        for (int e = 0; e < GRAPH_EDGES; ++e)
+            node->edges[e] = i > 0 ? slots[rand() % slotCount] : NULL;
+        BenchDrop(allocator, slots[slot]);
+        slots[slot] = node;
+    }
+    for (int i = 0; i < slotCount; ++i) {
+        if (slots[i] == NULL || slots[i]->id < 0) {
+            fprintf(stderr, "Random graph is corrupted\n");
+            exit(1);
+        }
+    }
+    if (allocator->useGC)
+        GCRemoveRoot(allocator->gCollector, slots);
+    else
+        for (int i = 0; i < slotCount; ++i)
+            free(slots[i]);
+    free(slots);
+}
+
+//Allocation storm: millions of small objects that die right away.
+
+void AllocationStormWorkload(BenchAllocator *allocator, int scale) {
+    int count = 2000000 * scale;
+    int64 checksum = 0;
+    for (int i = 0; i < count; ++i) {
+        int64 *object = BenchMalloc(allocator, 16 + (size_t) (i % 4) * 16);
+        object[0] = i;
+        object[1] = -i;
+        checksum += object[0] + object[1];
+        BenchDrop(allocator, object);
+    }
+    if (checksum != 0) {
+        fprintf(stderr, "Allocation storm is corrupted\n");
+        exit(1);
+    }
+}
+
+//Large buffers between 64 KB and 2 MB mixed with small objects, the last few buffers stay alive.
+
+#define LARGE_WINDOW 16
+
+void LargeBufferWorkload(BenchAllocator *allocator, int scale) {
+    uint8 **window = calloc(LARGE_WINDOW, sizeof(uint8 *));
+    if (allocator->useGC)
+        GCAddRoot(allocator->gCollector, window, LARGE_WINDOW * (int) sizeof(uint8 *));
+    srand(7);
+    for (int i = 0; i < 1000 * scale; ++i) {
+        size_t size = (size_t) 64 << 10 << (rand() % 6);
+        uint8 *buffer = BenchMalloc(allocator, size);
+        MemoryClear(buffer, size);
+        buffer[size - 1] = (uint8) i;
+        for (int j = 0; j < 32; ++j)
+            BenchDrop(allocator, BenchMalloc(allocator, 16 + (size_t) (j % 8) * 8));
+        BenchDrop(allocator, window[i % LARGE_WINDOW]);
+        window[i % LARGE_WINDOW] = buffer;
+    }
+    for (int i = 0; i < LARGE_WINDOW; ++i) {
+        if (allocator->useGC)
+            window[i] = NULL;
+        else
+            free(window[i]);
+    }
+    if (allocator->useGC)
+        GCRemoveRoot(allocator->gCollector, window);
+    free(window);
+}
+
+//Short-lived objects: request-sized batches of temporaries that die right away, a few results of every batch are
+//kept in a long-lived cache that is older than all of them.
+
+#define CACHE_SLOTS 4096
+
+typedef struct {
+    int64 key;
+    int64 payload[5];
+} CacheItem;
+
+void ShortLivedWorkload(BenchAllocator *allocator, int scale) {
+    CacheItem **cache = BenchMalloc(allocator, CACHE_SLOTS * sizeof(CacheItem *));
+    for (int i = 0; i < CACHE_SLOTS; ++i)
+        cache[i] = NULL;
+    srand(11);
+    int64 checksum = 0;
+    for (int request = 0; request < 20000 * scale; ++request) {
+        ListNode *temporaries = NULL;
+        for (int i = 0; i < 64; ++i) {
+            ListNode *node = BenchMalloc(allocator, sizeof(ListNode) + (size_t) (i % 4) * 16);
+            node->next = temporaries;
+            node->value = request + i;
+            temporaries = node;
+        }
+        for (ListNode *node = temporaries; node != NULL; node = node->next)
+            checksum += node->value - request;
+        while (temporaries != NULL) {
+            ListNode *next = temporaries->next;
+            BenchDrop(allocator, temporaries);
+            temporaries = next;
+        }
+        if (request % 4 == 0) {
+            CacheItem *item = BenchMalloc(allocator, sizeof(CacheItem));
+            item->key = request;
+            for (int i = 0; i < 5; ++i)
+                item->payload[i] = request * 5 + i;
+            int slot = rand() % CACHE_SLOTS;
+            BenchDrop(allocator, cache[slot]);
+            BenchStore(allocator, &cache[slot], item);
+        }
+    }
+    for (int i = 0; i < CACHE_SLOTS; ++i) {
+        if (cache[i] != NULL && cache[i]->payload[4] != cache[i]->key * 5 + 4) {
+            fprintf(stderr, "Short-lived cache is corrupted\n");
+            exit(1);
+        }
+        BenchDrop(allocator, cache[i]);
+    }
+    BenchDrop(allocator, cache);
+    if (checksum != (int64) 20000 * scale * (63 * 64 / 2)) {
+        fprintf(stderr, "Short-lived temporaries are corrupted\n");
+        exit(1);
+    }
+}
+
+typedef struct {
+    const char *name;
+    BenchWorkload run;
+} BenchEntry;
+
+BenchEntry workloads[] = {
+        {"binary-trees",  BinaryTreesWorkload},
+        {"linked-list",   LinkedListWorkload},
+        {"random-graph",  RandomGraphWorkload},
+        {"alloc-storm",   AllocationStormWorkload},
+        {"large-buffers", LargeBufferWorkload},
+        {"short-lived",   ShortLivedWorkload},
+};
+
+void RunBenchmark(BenchEntry *entry, BenchMode mode, int scale, void *stackTop) {
+    GCollector gCollector;
+    bool useGC = mode != BENCH_MALLOC;
+    BenchAllocator allocator = {useGC, &gCollector, 0, 0, 0, 0, 0, 0, 0};
+    if (useGC) {
+        GCInit(&gCollector, stackTop);
+        gCollector.collectThreshold = BENCH_BASE_THRESHOLD;
+        GCSetCycleCallback(&gCollector, BenchCycleCallback, &allocator);
+        if (mode == BENCH_GC_GENERATIONAL && !GCEnableGenerational(&gCollector, BENCH_NURSERY_BYTES)) {
+            fprintf(stderr, "Cannot allocate the nursery\n");
+            exit(1);
+        }
+    }
+    uint64 startTime = GetTimeMicroSeconds();
+    entry->run(&allocator, scale);
+    uint64 elapsed = GetTimeMicroSeconds() - startTime;
+    if (elapsed == 0)
+        elapsed = 1;
+    if (useGC)
+        GCEnd(&gCollector);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%-14s %-7s %10llu %10.1f %9.1f %12.0f %9.1f %9.1f %7d %10llu %7d %10llu %9.1f\n", entry->name,
+           modeNames[mode], allocator.allocCount, allocator.allocBytes / 1048576.0, elapsed / 1000.0,
+           allocator.allocCount * 1e6 / elapsed, allocator.allocBytes / 1.048576 / elapsed,
+           allocator.gcTime / 1000.0, allocator.majorCycles, allocator.maxMajorPause, allocator.minorCycles,
+           allocator.maxMinorPause, usage.ru_maxrss / 1024.0);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    int scale = argc > 1 ? atoi(argv[1]) : 1;
+    const char *only = argc > 2 ? argv[2] : NULL;
+    if (scale < 1)
+        scale = 1;
+    printf("%-14s %-7s %10s %10s %9s %12s %9s %9s %7s %10s %7s %10s %9s\n", "workload", "alloc", "allocs", "MB",
+           "time ms", "allocs/s", "MB/s", "GC ms", "majors", "major us", "minors", "minor us", "RSS MB");
+    fflush(stdout);
+    int failures = 0;
+    for (int i = 0; i < (int) (sizeof(workloads) / sizeof(workloads[0])); ++i) {
+        if (only != NULL && strcmp(only, workloads[i].name) != 0)
+            continue;
+        for (int mode = BENCH_GC_GENERATIONAL; mode >= BENCH_MALLOC; --mode) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                RunBenchmark(workloads + i, mode, scale, &argc);
+                exit(0);
+            }
+            int status = 1;
+            if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "%s (%s) failed\n", workloads[i].name, modeNames[mode]);
+                failures++;
+            }
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
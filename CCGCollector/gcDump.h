@@ -0,0 +1,35 @@
+#ifndef INC_GC_DUMP
+#define INC_GC_DUMP
+
+#include "ccCommon.h"
+
+#define GC_DUMP_MAGIC 0x44474343ULL
+#define GC_DUMP_VERSION 2
+
+typedef enum {
+    GC_DUMP_HEADER = 1,
+    GC_DUMP_RECORD,
+    GC_DUMP_EDGE,
+    GC_DUMP_ROOT,
+    GC_DUMP_END
+} GCDumpTag;
+
+typedef enum {
+    GC_ROOT_STACK,
+    GC_ROOT_REGISTERED
+} GCRootOrigin;
+
+//A dump is a stream of fixed-size entries in host byte order, the fields mean:
+//  HEADER: flags = GC_DUMP_VERSION, a = GC_DUMP_MAGIC, b = record count
+//  RECORD: flags = 0, a = record address, b = record size
+//  EDGE:   a = source record, b = target record, c = offset of the slot inside the source
+//  ROOT:   flags = GCRootOrigin, a = slot address, b = target record
+//  END:    a = edge count, b = root count
+//Edges of a record always follow its RECORD entry. Version 1 dumps carried the collector's mark state in the RECORD
+//flags, readers ignore it.
+typedef struct {
+    uint32 tag, flags;
+    uint64 a, b, c;
+} GCDumpEntry;
+
+#endif
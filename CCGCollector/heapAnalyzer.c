@@ -0,0 +1,491 @@
+//Offline reader for dumps written by GCDumpHeap.
+//Usage: heapAnalyzer <dump> [--top N] [--tree DEPTH] [--path ADDRESS]
+//Node 0 of the graph is a virtual root with an edge to every root slot target, node i + 1 is objects[i].
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gcDump.h"
+
+typedef struct {
+    uint64 address, size;
+} HeapObject;
+
+typedef struct {
+    uint64 slot;
+    int target;
+    GCRootOrigin origin;
+} HeapRoot;
+
+typedef struct {
+    HeapObject *objects;
+    int objectCount, nodeCount;
+    HeapRoot *roots;
+    int rootCount;
+    int *succStart, *succ;
+    int *predStart, *pred;
+} HeapGraph;
+
+typedef struct {
+    int *rpo, *rpoIndex;
+    int reachableCount;
+    int *idom;
+    uint64 *retained;
+    int *bfsParent, *bfsRoot;
+} HeapAnalysis;
+
+void *CheckedMalloc(size_t size) {
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+void *CheckedRealloc(void *ptr, size_t size) {
+    ptr = realloc(ptr, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+int CompareObjects(const void *a, const void *b) {
+    uint64 x = ((const HeapObject *) a)->address, y = ((const HeapObject *) b)->address;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+//Returns the index of the object containing address, or -1.
+int FindObject(HeapGraph *graph, uint64 address) {
+    int low = 0, high = graph->objectCount - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        HeapObject *object = graph->objects + mid;
+        if (address < object->address)
+            high = mid - 1;
+        else if (address >= object->address + (object->size ? object->size : 1))
+            low = mid + 1;
+        else
+            return mid;
+    }
+    return -1;
+}
+
+//Builds a compressed adjacency list from parallel from/to arrays.
+void BuildAdjacency(int nodeCount, int *from, int *to, int edgeCount, int **startOut, int **listOut) {
+    int *start = CheckedMalloc((nodeCount + 1) * sizeof(int));
+    int *list = CheckedMalloc(edgeCount * sizeof(int));
+    MemoryClear(start, (nodeCount + 1) * sizeof(int));
+    for (int i = 0; i < edgeCount; ++i)
+        start[from[i] + 1] += 1;
+    for (int i = 0; i < nodeCount; ++i)
+        start[i + 1] += start[i];
+    int *fill = CheckedMalloc(nodeCount * sizeof(int));
+    MemoryCopy(start, fill, nodeCount * sizeof(int));
+    for (int i = 0; i < edgeCount; ++i)
+        list[fill[from[i]]++] = to[i];
+    free(fill);
+    *startOut = start;
+    *listOut = list;
+}
+
+bool LoadHeapDump(const char *path, HeapGraph *graph) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    GCDumpEntry entry;
+    if (fread(&entry, sizeof(GCDumpEntry), 1, file) != 1 || entry.tag != GC_DUMP_HEADER ||
+        entry.a != GC_DUMP_MAGIC || entry.flags < 1 || entry.flags > GC_DUMP_VERSION) {
+        fprintf(stderr, "%s is not a version 1 to %d heap dump\n", path, GC_DUMP_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    int objectCapacity = entry.b > 0 ? (int) entry.b : 16, edgeCapacity = 16, rootCapacity = 16;
+    int edgeCount = 0;
+    uint64 *edgeFrom = CheckedMalloc(edgeCapacity * sizeof(uint64));
+    uint64 *edgeTo = CheckedMalloc(edgeCapacity * sizeof(uint64));
+    uint64 *rootTargets = CheckedMalloc(rootCapacity * sizeof(uint64));
+    graph->objects = CheckedMalloc(objectCapacity * sizeof(HeapObject));
+    graph->roots = CheckedMalloc(rootCapacity * sizeof(HeapRoot));
+    graph->objectCount = 0;
+    graph->rootCount = 0;
+    bool ended = false;
+    while (!ended && fread(&entry, sizeof(GCDumpEntry), 1, file) == 1) {
+        switch (entry.tag) {
+            case GC_DUMP_RECORD:
+                if (graph->objectCount == objectCapacity) {
+                    objectCapacity *= 2;
+                    graph->objects = CheckedRealloc(graph->objects, objectCapacity * sizeof(HeapObject));
+                }
+                graph->objects[graph->objectCount++] = (HeapObject) {entry.a, entry.b};
+                break;
+            case GC_DUMP_EDGE:
+                if (edgeCount == edgeCapacity) {
+                    edgeCapacity *= 2;
+                    edgeFrom = CheckedRealloc(edgeFrom, edgeCapacity * sizeof(uint64));
+                    edgeTo = CheckedRealloc(edgeTo, edgeCapacity * sizeof(uint64));
+                }
+                edgeFrom[edgeCount] = entry.a;
+                edgeTo[edgeCount] = entry.b;
+                edgeCount++;
+                break;
+            case GC_DUMP_ROOT:
+                if (graph->rootCount == rootCapacity) {
+                    rootCapacity *= 2;
+                    graph->roots = CheckedRealloc(graph->roots, rootCapacity * sizeof(HeapRoot));
+                    rootTargets = CheckedRealloc(rootTargets, rootCapacity * sizeof(uint64));
+                }
+                graph->roots[graph->rootCount] = (HeapRoot) {entry.a, -1, (GCRootOrigin) entry.flags};
+                rootTargets[graph->rootCount] = entry.b;
+                graph->rootCount++;
+                break;
+            case GC_DUMP_END:
+                ended = true;
+                break;
+            default:
+                fprintf(stderr, "Unknown entry tag %u in %s\n", entry.tag, path);
+                break;
+        }
+    }
+    fclose(file);
+    if (!ended)
+        fprintf(stderr, "Warning: %s is truncated, analyzing what was read\n", path);
+
+    qsort(graph->objects, graph->objectCount, sizeof(HeapObject), CompareObjects);
+    graph->nodeCount = graph->objectCount + 1;
+
+    int totalEdges = edgeCount + graph->rootCount;
+    int *from = CheckedMalloc(totalEdges * sizeof(int));
+    int *to = CheckedMalloc(totalEdges * sizeof(int));
+    int edgeIndex = 0;
+    for (int i = 0; i < graph->rootCount; ++i) {
+        int target = FindObject(graph, rootTargets[i]);
+        graph->roots[i].target = target;
+        if (target < 0)
+            continue;
+        from[edgeIndex] = 0;
+        to[edgeIndex] = target + 1;
+        edgeIndex++;
+    }
+    for (int i = 0; i < edgeCount; ++i) {
+        int source = FindObject(graph, edgeFrom[i]), target = FindObject(graph, edgeTo[i]);
+        if (source < 0 || target < 0)
+            continue;
+        from[edgeIndex] = source + 1;
+        to[edgeIndex] = target + 1;
+        edgeIndex++;
+    }
+    BuildAdjacency(graph->nodeCount, from, to, edgeIndex, &graph->succStart, &graph->succ);
+    BuildAdjacency(graph->nodeCount, to, from, edgeIndex, &graph->predStart, &graph->pred);
+
+    free(from);
+    free(to);
+    free(edgeFrom);
+    free(edgeTo);
+    free(rootTargets);
+    return true;
+}
+
+//Reverse postorder of the nodes reachable from the virtual root, using an explicit stack.
+void ComputeReversePostorder(HeapGraph *graph, HeapAnalysis *analysis) {
+    int nodeCount = graph->nodeCount;
+    int *stack = CheckedMalloc(nodeCount * sizeof(int));
+    int *nextEdge = CheckedMalloc(nodeCount * sizeof(int));
+    bool *visited = CheckedMalloc(nodeCount * sizeof(bool));
+    int *postorder = CheckedMalloc(nodeCount * sizeof(int));
+    MemoryClear(visited, nodeCount * sizeof(bool));
+    int depth = 0, postCount = 0;
+    stack[depth++] = 0;
+    visited[0] = true;
+    nextEdge[0] = graph->succStart[0];
+    while (depth > 0) {
+        int node = stack[depth - 1];
+        if (nextEdge[node] < graph->succStart[node + 1]) {
+            int child = graph->succ[nextEdge[node]++];
+            if (!visited[child]) {
+                visited[child] = true;
+                nextEdge[child] = graph->succStart[child];
+                stack[depth++] = child;
+            }
+        } else {
+            postorder[postCount++] = node;
+            depth--;
+        }
+    }
+    analysis->reachableCount = postCount;
+    analysis->rpo = CheckedMalloc(postCount * sizeof(int));
+    analysis->rpoIndex = CheckedMalloc(nodeCount * sizeof(int));
+    for (int i = 0; i < nodeCount; ++i)
+        analysis->rpoIndex[i] = -1;
+    for (int i = 0; i < postCount; ++i) {
+        analysis->rpo[i] = postorder[postCount - 1 - i];
+        analysis->rpoIndex[analysis->rpo[i]] = i;
+    }
+    free(stack);
+    free(nextEdge);
+    free(visited);
+    free(postorder);
+}
+
+int IntersectDominators(HeapAnalysis *analysis, int a, int b) {
+    while (a != b) {
+        while (analysis->rpoIndex[a] > analysis->rpoIndex[b])
+            a = analysis->idom[a];
+        while (analysis->rpoIndex[b] > analysis->rpoIndex[a])
+            b = analysis->idom[b];
+    }
+    return a;
+}
+
+//Iterative dominator algorithm by Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+void ComputeDominators(HeapGraph *graph, HeapAnalysis *analysis) {
+    analysis->idom = CheckedMalloc(graph->nodeCount * sizeof(int));
+    for (int i = 0; i < graph->nodeCount; ++i)
+        analysis->idom[i] = -1;
+    analysis->idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < analysis->reachableCount; ++i) {
+            int node = analysis->rpo[i];
+            int newIdom = -1;
+            for (int e = graph->predStart[node]; e < graph->predStart[node + 1]; ++e) {
+                int pred = graph->pred[e];
+                if (analysis->idom[pred] == -1)
+                    continue;
+                newIdom = newIdom == -1 ? pred : IntersectDominators(analysis, pred, newIdom);
+            }
+            if (newIdom != analysis->idom[node]) {
+                analysis->idom[node] = newIdom;
+                changed = true;
+            }
+        }
+    }
+
+    analysis->retained = CheckedMalloc(graph->nodeCount * sizeof(uint64));
+    MemoryClear(analysis->retained, graph->nodeCount * sizeof(uint64));
+    for (int i = analysis->reachableCount - 1; i > 0; --i) {
+        int node = analysis->rpo[i];
+        analysis->retained[node] += graph->objects[node - 1].size;
+        analysis->retained[analysis->idom[node]] += analysis->retained[node];
+    }
+}
+
+//Breadth-first search from the roots, bfsRoot remembers which root slot each path starts from.
+void ComputeShortestPaths(HeapGraph *graph, HeapAnalysis *analysis) {
+    int nodeCount = graph->nodeCount;
+    int *queue = CheckedMalloc(nodeCount * sizeof(int));
+    analysis->bfsParent = CheckedMalloc(nodeCount * sizeof(int));
+    analysis->bfsRoot = CheckedMalloc(nodeCount * sizeof(int));
+    for (int i = 0; i < nodeCount; ++i) {
+        analysis->bfsParent[i] = -1;
+        analysis->bfsRoot[i] = -1;
+    }
+    int head = 0, tail = 0;
+    analysis->bfsParent[0] = 0;
+    for (int i = 0; i < graph->rootCount; ++i) {
+        int node = graph->roots[i].target + 1;
+        if (node == 0 || analysis->bfsParent[node] != -1)
+            continue;
+        analysis->bfsParent[node] = 0;
+        analysis->bfsRoot[node] = i;
+        queue[tail++] = node;
+    }
+    while (head < tail) {
+        int node = queue[head++];
+        for (int e = graph->succStart[node]; e < graph->succStart[node + 1]; ++e) {
+            int child = graph->succ[e];
+            if (analysis->bfsParent[child] != -1)
+                continue;
+            analysis->bfsParent[child] = node;
+            analysis->bfsRoot[child] = analysis->bfsRoot[node];
+            queue[tail++] = child;
+        }
+    }
+    free(queue);
+}
+
+//The collector keeps every object whose start is referenced by a root or by any record, reachable or not, which is
+//an object with at least one incoming edge.
+void OutputSummary(HeapGraph *graph, HeapAnalysis *analysis) {
+    uint64 totalBytes = 0, markedBytes = 0, strayBytes = 0;
+    int markedCount = 0, strayCount = 0, stackRoots = 0;
+    for (int i = 0; i < graph->objectCount; ++i) {
+        HeapObject *object = graph->objects + i;
+        totalBytes += object->size;
+        if (graph->predStart[i + 1] == graph->predStart[i + 2])
+            continue;
+        markedCount++;
+        markedBytes += object->size;
+        if (analysis->rpoIndex[i + 1] == -1) {
+            strayCount++;
+            strayBytes += object->size;
+        }
+    }
+    for (int i = 0; i < graph->rootCount; ++i)
+        if (graph->roots[i].origin == GC_ROOT_STACK)
+            stackRoots++;
+    printf("Heap Summary:\n");
+    printf("\t Objects: %d \t Total size: %llu bytes\n", graph->objectCount, totalBytes);
+    printf("\t Root slots: %d on stack, %d registered\n", stackRoots, graph->rootCount - stackRoots);
+    printf("\t Reachable from roots: %d objects, %llu bytes\n", analysis->reachableCount - 1, analysis->retained[0]);
+    printf("\t Marked by collector: %d objects, %llu bytes\n", markedCount, markedBytes);
+    printf("\t Marked but unreachable: %d objects, %llu bytes\n", strayCount, strayBytes);
+}
+
+int *SortByRetained(HeapAnalysis *analysis, int *nodes, int count) {
+    //Insertion sort keeps this dependency free; callers only sort short child lists or the top N.
+    for (int i = 1; i < count; ++i) {
+        int node = nodes[i], j = i - 1;
+        while (j >= 0 && analysis->retained[nodes[j]] < analysis->retained[node]) {
+            nodes[j + 1] = nodes[j];
+            j--;
+        }
+        nodes[j + 1] = node;
+    }
+    return nodes;
+}
+
+void OutputTopRetainers(HeapGraph *graph, HeapAnalysis *analysis, int topCount) {
+    if (topCount > analysis->reachableCount - 1)
+        topCount = analysis->reachableCount - 1;
+    int *top = CheckedMalloc((topCount + 1) * sizeof(int));
+    int found = 0;
+    for (int i = 1; i < analysis->reachableCount; ++i) {
+        int node = analysis->rpo[i];
+        if (found < topCount) {
+            top[found++] = node;
+            SortByRetained(analysis, top, found);
+        } else if (topCount > 0 && analysis->retained[node] > analysis->retained[top[topCount - 1]]) {
+            top[topCount - 1] = node;
+            SortByRetained(analysis, top, topCount);
+        }
+    }
+    printf("Top %d objects by retained size:\n", found);
+    for (int i = 0; i < found; ++i) {
+        int node = top[i], idom = analysis->idom[node];
+        HeapObject *object = graph->objects + node - 1;
+        if (idom == 0)
+            printf("\t [%#llx] size %llu retained %llu dominated by <roots>\n", object->address, object->size,
+                   analysis->retained[node]);
+        else
+            printf("\t [%#llx] size %llu retained %llu dominated by [%#llx]\n", object->address, object->size,
+                   analysis->retained[node], graph->objects[idom - 1].address);
+    }
+    free(top);
+}
+
+void OutputDominatorTree(HeapGraph *graph, HeapAnalysis *analysis, int maxDepth) {
+    int *childStart, *children;
+    int *from = CheckedMalloc(analysis->reachableCount * sizeof(int));
+    int *to = CheckedMalloc(analysis->reachableCount * sizeof(int));
+    int count = 0;
+    for (int i = 1; i < analysis->reachableCount; ++i) {
+        from[count] = analysis->idom[analysis->rpo[i]];
+        to[count] = analysis->rpo[i];
+        count++;
+    }
+    BuildAdjacency(graph->nodeCount, from, to, count, &childStart, &children);
+    free(from);
+    free(to);
+
+    printf("Dominator tree (depth %d):\n", maxDepth);
+    printf("\t <roots> retained %llu\n", analysis->retained[0]);
+    int *stack = CheckedMalloc(analysis->reachableCount * sizeof(int));
+    int *depths = CheckedMalloc(analysis->reachableCount * sizeof(int));
+    int top = 0;
+    SortByRetained(analysis, children + childStart[0], childStart[1] - childStart[0]);
+    for (int e = childStart[1] - 1; e >= childStart[0]; --e) {
+        stack[top] = children[e];
+        depths[top++] = 1;
+    }
+    while (top > 0) {
+        int node = stack[--top], depth = depths[top];
+        HeapObject *object = graph->objects + node - 1;
+        printf("\t %*s[%#llx] size %llu retained %llu\n", depth * 2, "", object->address, object->size,
+               analysis->retained[node]);
+        if (depth >= maxDepth)
+            continue;
+        SortByRetained(analysis, children + childStart[node], childStart[node + 1] - childStart[node]);
+        for (int e = childStart[node + 1] - 1; e >= childStart[node]; --e) {
+            stack[top] = children[e];
+            depths[top++] = depth + 1;
+        }
+    }
+    free(stack);
+    free(depths);
+    free(childStart);
+    free(children);
+}
+
+void OutputRootPath(HeapGraph *graph, HeapAnalysis *analysis, uint64 address) {
+    int index = FindObject(graph, address);
+    if (index < 0) {
+        printf("No object contains [%#llx]\n", address);
+        return;
+    }
+    int node = index + 1;
+    if (analysis->bfsParent[node] == -1) {
+        printf("[%#llx] is not reachable from any root\n", graph->objects[index].address);
+        return;
+    }
+    int length = 0;
+    for (int current = node; current != 0; current = analysis->bfsParent[current])
+        length++;
+    int *path = CheckedMalloc(length * sizeof(int));
+    int position = length;
+    for (int current = node; current != 0; current = analysis->bfsParent[current])
+        path[--position] = current;
+    HeapRoot *root = graph->roots + analysis->bfsRoot[node];
+    printf("Shortest root path to [%#llx]:\n", graph->objects[index].address);
+    printf("\t %s slot [%#llx]\n", root->origin == GC_ROOT_STACK ? "stack" : "registered root", root->slot);
+    for (int i = 0; i < length; ++i) {
+        HeapObject *object = graph->objects + path[i] - 1;
+        printf("\t -> [%#llx] size %llu\n", object->address, object->size);
+    }
+    free(path);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <dump> [--top N] [--tree DEPTH] [--path ADDRESS]\n", argv[0]);
+        return 1;
+    }
+    int topCount = 10, treeDepth = 0;
+    bool hasPath = false;
+    uint64 pathAddress = 0;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--top") == 0) {
+            topCount = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--tree") == 0) {
+            treeDepth = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--path") == 0) {
+            hasPath = true;
+            pathAddress = strtoull(argv[i + 1], NULL, 16);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    HeapGraph graph;
+    if (!LoadHeapDump(argv[1], &graph))
+        return 1;
+    HeapAnalysis analysis;
+    ComputeReversePostorder(&graph, &analysis);
+    ComputeDominators(&graph, &analysis);
+    ComputeShortestPaths(&graph, &analysis);
+
+    OutputSummary(&graph, &analysis);
+    OutputTopRetainers(&graph, &analysis, topCount);
+    if (treeDepth > 0)
+        OutputDominatorTree(&graph, &analysis, treeDepth);
+    if (hasPath)
+        OutputRootPath(&graph, &analysis, pathAddress);
+    return 0;
+}
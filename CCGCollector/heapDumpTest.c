@@ -0,0 +1,135 @@
+//Writes a dump of a known heap with GCDumpHeap and checks what heapAnalyzer makes of it.
+//Usage: heapDumpTest <heapAnalyzer> [dump]
+//The heap is a registered root slot -> A -> B -> C chain plus an object nothing points at.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gCollector.h"
+
+#define TEST_MASK 0x5A5A5A5A5A5A5A5AULL
+#define TEST_OUTPUT_SIZE (64 << 10)
+
+typedef struct {
+    uint64 maskedAddress;
+    size_t size;
+} TestObject;
+
+//Masked so the data segment does not hold the addresses either.
+TestObject chain[3] = {{0, 64}, {0, 128}, {0, 256}};
+TestObject unreachable = {0, 32};
+int failures = 0;
+
+void BuildHeap(GCollector *gCollector, void **rootSlot) {
+    void *garbage = GCMalloc(gCollector, unreachable.size);
+    MemoryClear(garbage, unreachable.size);
+    unreachable.maskedAddress = (uint64) garbage ^ TEST_MASK;
+    void **previous = NULL;
+    for (int i = 0; i < 3; ++i) {
+        void **object = GCMalloc(gCollector, chain[i].size);
+        MemoryClear(object, chain[i].size);
+        if (previous != NULL)
+            previous[1] = object;
+        else
+            *rootSlot = object;
+        chain[i].maskedAddress = (uint64) object ^ TEST_MASK;
+        previous = object;
+    }
+}
+
+void RunAnalyzer(const char *analyzer, const char *dumpPath, const char *options, char *output) {
+    char command[4096];
+    snprintf(command, sizeof(command), "\"%s\" \"%s\" %s", analyzer, dumpPath, options);
+    output[0] = '\0';
+    FILE *pipe = popen(command, "r");
+    if (pipe == NULL) {
+        fprintf(stderr, "FAILED: cannot run %s\n", command);
+        failures++;
+        return;
+    }
+    size_t length = fread(output, 1, TEST_OUTPUT_SIZE - 1, pipe);
+    output[length] = '\0';
+    if (pclose(pipe) != 0) {
+        fprintf(stderr, "FAILED: %s exited with an error\n", command);
+        failures++;
+    }
+}
+
+void Expect(const char *output, const char *line) {
+    if (strstr(output, line) == NULL) {
+        fprintf(stderr, "FAILED: expected \"%s\" in:\n%s\n", line, output);
+        failures++;
+    }
+}
+
+void ExpectObject(const char *output, const char *format, TestObject *object, uint64 retained, TestObject *dominator) {
+    char line[256];
+    if (dominator == NULL)
+        snprintf(line, sizeof(line), format, object->maskedAddress ^ TEST_MASK, (uint64) object->size, retained);
+    else
+        snprintf(line, sizeof(line), format, object->maskedAddress ^ TEST_MASK, (uint64) object->size, retained,
+                 dominator->maskedAddress ^ TEST_MASK);
+    Expect(output, line);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <heapAnalyzer> [dump]\n", argv[0]);
+        return 1;
+    }
+    const char *dumpPath = argc > 2 ? argv[2] : "heapDumpTest.dump";
+    GCollector gCollector;
+    GCInit(&gCollector, &argc);
+    //No collection may run before the dump, the unreachable object has to be in it.
+    gCollector.collectThreshold = 1 << 30;
+    void **rootSlots = calloc(2, sizeof(void *));
+    GCAddRoot(&gCollector, rootSlots, 2 * (int) sizeof(void *));
+    BuildHeap(&gCollector, rootSlots);
+    //Leftovers of dead frames would make stack roots, and with them the expected graph, depend on the compiler. A
+    //frame top below every frame turns the stack scan off so only the registered root counts.
+    gCollector.FrameTop = NULL;
+    if (!GCDumpHeap(&gCollector, dumpPath)) {
+        fprintf(stderr, "FAILED: cannot write %s\n", dumpPath);
+        return 1;
+    }
+    uint64 rootSlot = (uint64) rootSlots;
+    GCRemoveRoot(&gCollector, rootSlots);
+    free(rootSlots);
+    GCEnd(&gCollector);
+
+    char *output = malloc(TEST_OUTPUT_SIZE);
+    char line[256], options[64];
+    RunAnalyzer(argv[1], dumpPath, "--tree 3", output);
+    Expect(output, "Objects: 4 \t Total size: 480 bytes");
+    Expect(output, "Root slots: 0 on stack, 1 registered");
+    Expect(output, "Reachable from roots: 3 objects, 448 bytes");
+    Expect(output, "Marked by collector: 3 objects, 448 bytes");
+    ExpectObject(output, "[%#llx] size %llu retained %llu dominated by <roots>", chain, 448, NULL);
+    ExpectObject(output, "[%#llx] size %llu retained %llu dominated by [%#llx]", chain + 1, 384, chain);
+    ExpectObject(output, "[%#llx] size %llu retained %llu dominated by [%#llx]", chain + 2, 256, chain + 1);
+    Expect(output, "<roots> retained 448");
+    ExpectObject(output, "\t   [%#llx] size %llu retained %llu\n", chain, 448, NULL);
+    ExpectObject(output, "\t     [%#llx] size %llu retained %llu\n", chain + 1, 384, NULL);
+    ExpectObject(output, "\t       [%#llx] size %llu retained %llu\n", chain + 2, 256, NULL);
+
+    snprintf(options, sizeof(options), "--path %llx", chain[2].maskedAddress ^ TEST_MASK);
+    RunAnalyzer(argv[1], dumpPath, options, output);
+    snprintf(line, sizeof(line), "registered root slot [%#llx]\n", rootSlot);
+    Expect(output, line);
+    for (int i = 0; i < 3; ++i) {
+        snprintf(line, sizeof(line), "-> [%#llx] size %llu\n", chain[i].maskedAddress ^ TEST_MASK,
+                 (uint64) chain[i].size);
+        Expect(output, line);
+    }
+
+    snprintf(options, sizeof(options), "--path %llx", unreachable.maskedAddress ^ TEST_MASK);
+    RunAnalyzer(argv[1], dumpPath, options, output);
+    snprintf(line, sizeof(line), "[%#llx] is not reachable from any root", unreachable.maskedAddress ^ TEST_MASK);
+    Expect(output, line);
+
+    free(output);
+    remove(dumpPath);
+    if (failures == 0)
+        printf("heapDumpTest passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+//Throughput of the ccCommon memory primitives against libc, from 8 bytes up to 1 GB.
+//Usage: memoryBench [maxBytes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ccCommon.h"
+
+#define BENCH_BYTES_PER_RUN ((size_t) 256 << 20)
+#define BENCH_MOVE_SHIFT 8
+
+typedef enum {
+    BENCH_CLEAR,
+    BENCH_COPY,
+    BENCH_MOVE,
+    BENCH_COMPARE
+} BenchOperation;
+
+const char *operationNames[] = {"clear", "copy", "move", "compare"};
+
+volatile int benchSink;
+
+void RunOperation(BenchOperation operation, bool useLibc, uint8 *src, uint8 *dst, size_t size) {
+    switch (operation) {
+        case BENCH_CLEAR:
+            if (useLibc)
+                memset(dst, 0, size);
+            else
+                MemoryClear(dst, size);
+            break;
+        case BENCH_COPY:
+            if (useLibc)
+                memcpy(dst, src, size);
+            else
+                MemoryCopy(src, dst, size);
+            break;
+        case BENCH_MOVE:
+            if (useLibc)
+                memmove(dst + BENCH_MOVE_SHIFT, dst, size);
+            else
+                MemoryMove(dst, dst + BENCH_MOVE_SHIFT, size);
+            break;
+        case BENCH_COMPARE:
+            benchSink += useLibc ? memcmp(src, dst, size) : MemoryCompare(src, dst, size);
+            break;
+    }
+}
+
+//Returns the throughput in GB/s, one warm-up call runs first so page faults stay out of the measurement.
+double MeasureOperation(BenchOperation operation, bool useLibc, uint8 *src, uint8 *dst, size_t size) {
+    if (operation == BENCH_COMPARE)
+        memcpy(dst, src, size);
+    RunOperation(operation, useLibc, src, dst, size);
+    size_t iterations = BENCH_BYTES_PER_RUN / size;
+    if (iterations == 0)
+        iterations = 1;
+    uint64 startTime = GetTimeMicroSeconds();
+    for (size_t i = 0; i < iterations; ++i)
+        RunOperation(operation, useLibc, src, dst, size);
+    uint64 elapsed = GetTimeMicroSeconds() - startTime;
+    benchSink += dst[size / 2];
+    if (elapsed == 0)
+        elapsed = 1;
+    return (double) size * (double) iterations / (double) elapsed / 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    size_t maxSize = argc > 1 ? strtoull(argv[1], NULL, 10) : (size_t) 1 << 30;
+    uint8 *src = malloc(maxSize + BENCH_MOVE_SHIFT);
+    uint8 *dst = malloc(maxSize + BENCH_MOVE_SHIFT);
+    if (src == NULL || dst == NULL) {
+        fprintf(stderr, "Cannot allocate 2 x %zu bytes\n", maxSize);
+        return 1;
+    }
+    for (size_t i = 0; i < maxSize + BENCH_MOVE_SHIFT; ++i)
+        src[i] = (uint8) (i * 131);
+    memset(dst, 0, maxSize + BENCH_MOVE_SHIFT);
+
+    printf("Memory kernels: %s\n", MemoryKernelName());
+    printf("%12s %8s %14s %14s %8s\n", "bytes", "op", "ccCommon GB/s", "libc GB/s", "ratio");
+    for (size_t size = 8; size <= maxSize; size *= 8) {
+        for (int operation = BENCH_CLEAR; operation <= BENCH_COMPARE; ++operation) {
+            double ours = MeasureOperation(operation, false, src, dst, size);
+            double libc = MeasureOperation(operation, true, src, dst, size);
+            printf("%12zu %8s %14.2f %14.2f %8.2f\n", size, operationNames[operation], ours, libc, ours / libc);
+        }
+    }
+    free(src);
+    free(dst);
+    return 0;
+}
@@ -0,0 +1,78 @@
+//Scripts the headroom seen by pressure mode through GCSimulatedMemorySource and checks which collections it runs.
+
+#include <stdio.h>
+#include "gCollector.h"
+
+#define TEST_LIMIT ((int64) 100 << 20)
+#define TEST_CHECK_INTERVAL (64 << 10)
+
+int failures = 0;
+
+void Expect(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+//Every allocation is exactly one check interval, so each one polls the source once.
+void AllocateChecks(GCollector *gCollector, int count) {
+    for (int i = 0; i < count; ++i)
+        GCMalloc(gCollector, TEST_CHECK_INTERVAL);
+}
+
+void SetHeadroom(GCMemoryStatus *status, double headroom) {
+    status->current = TEST_LIMIT - (int64) (headroom * (double) TEST_LIMIT);
+    status->rss = 0;
+}
+
+int main(int argc, char *argv[]) {
+    GCollector gCollector;
+    GCInit(&gCollector, &argc);
+    //Keep the regular threshold out of the way, only pressure may collect.
+    gCollector.collectThreshold = 1 << 30;
+    GCMemoryStatus status = {TEST_LIMIT, 0, 0};
+    GCEnablePressureMode(&gCollector, GCSimulatedMemorySource, &status);
+    gCollector.pressure.checkInterval = TEST_CHECK_INTERVAL;
+    GCPressureConfig *pressure = &gCollector.pressure;
+
+    SetHeadroom(&status, 0.5);
+    AllocateChecks(&gCollector, 4);
+    Expect(pressure->earlyCollections == 0 && pressure->emergencyCollections == 0,
+           "no collection with 50% headroom");
+
+    SetHeadroom(&status, 0.1);
+    AllocateChecks(&gCollector, 3);
+    Expect(pressure->earlyCollections == 3, "one early collection per check below the early watermark");
+    Expect(pressure->emergencyCollections == 0, "no emergency collection above the emergency watermark");
+
+    SetHeadroom(&status, 0.02);
+    AllocateChecks(&gCollector, 2);
+    Expect(pressure->earlyCollections == 3, "emergency checks are not counted as early");
+    Expect(pressure->emergencyCollections == 2, "one emergency collection per check below the emergency watermark");
+
+    //Smaller allocations only poll once a full interval has accumulated.
+    for (int i = 0; i < 4; ++i)
+        GCMalloc(&gCollector, TEST_CHECK_INTERVAL / 4);
+    Expect(pressure->emergencyCollections == 3, "small allocations poll once per interval");
+
+    SetHeadroom(&status, 0.5);
+    AllocateChecks(&gCollector, 2);
+    Expect(pressure->earlyCollections == 3 && pressure->emergencyCollections == 3,
+           "no collection once headroom recovers");
+
+    status.limit = -1;
+    SetHeadroom(&status, 0.0);
+    AllocateChecks(&gCollector, 2);
+    Expect(pressure->emergencyCollections == 3, "no collection without a limit");
+
+    GCDisablePressureMode(&gCollector);
+    status.limit = TEST_LIMIT;
+    AllocateChecks(&gCollector, 2);
+    Expect(pressure->emergencyCollections == 3, "no collection once pressure mode is disabled");
+
+    GCEnd(&gCollector);
+    if (failures == 0)
+        printf("pressureTest passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -1,3 +1,12 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <link.h>
+#include <pthread.h>
+#endif
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
 #include "TrackedMalloc.h"
 
 int init_finished = 0;
@@ -36,14 +45,11 @@ int mcLinkedListPush(mcLinkedList *list, void *data) {
     struct mcLinkedNode *node = mcAllocLinkedNode(data, dataSize);
     if (node == NULL)
         return 0;
-    if (list->head == NULL) {
+    if (list->head == NULL)
         list->head = node;
-    } else {
-        struct mcLinkedNode *current = list->head;
-        while (current->next != NULL)
-            current = current->next;
-        current->next = node;
-    }
+    else
+        list->tail->next = node;
+    list->tail = node;
     list->length++;
     return 1;
 }
@@ -55,12 +61,16 @@ int mcLinkedListRemove(mcLinkedList *list, int index) {
     if (index == 0) {
         removed = list->head;
         list->head = removed->next;
+        if (list->tail == removed)
+            list->tail = NULL;
     } else {
         struct mcLinkedNode *current = list->head;
         for (int i = 0; i < index - 1; ++i)
             current = current->next;
         removed = current->next;
         current->next = removed->next;
+        if (list->tail == removed)
+            list->tail = current;
     }
     mcFreeLinkedNode(removed);
     list->length--;
@@ -87,6 +97,9 @@ void mcFreeLinkedList(mcLinkedList *list) {
         mcFreeLinkedNode(current);
         current = next;
     }
+    list->head = NULL;
+    list->tail = NULL;
+    list->length = 0;
 }
 
 
@@ -110,13 +123,189 @@ int outputTraverse(int index, void *record) {
     return 1;
 }
 
+//Leak classification, a conservative mark pass in the spirit of CCGCollector's GCMark: every aligned word of the
+//writable data segments and, for on-demand checks, of the caller's live frames and spilled registers is a root, a
+//word anywhere inside a tracked block references it. The exit check scans no stack at all: main has returned and
+//what is left below __libc_start_main are dead frames. Blocks reached from the roots are still reachable. Each
+//remaining block in turn marks what it references as indirectly lost; those no other lost block points at are
+//definitely lost. Blocks are kept in an address-sorted array, so the whole pass is
+//O((blocks + scanned words) * log blocks).
+
+#define MC_UNSEEN (-1)
+#define MC_LEADER (-2)
+
+typedef struct {
+    uintptr_t begin, end;
+    mcMallocRecord *record;
+    int kind;
+} mcBlock;
+
+typedef struct {
+    mcBlock *blocks;
+    int blockCount;
+    int *pending;
+    int pendingCount;
+} mcLeakScan;
+
+int mcCompareBlocks(const void *a, const void *b) {
+    uintptr_t x = ((const mcBlock *) a)->begin, y = ((const mcBlock *) b)->begin;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+int mcFindBlock(mcLeakScan *scan, uintptr_t address) {
+    int low = 0, high = scan->blockCount - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (address < scan->blocks[mid].begin)
+            high = mid - 1;
+        else if (address >= scan->blocks[mid].end)
+            low = mid + 1;
+        else
+            return mid;
+    }
+    return -1;
+}
+
+void mcScanRange(mcLeakScan *scan, uintptr_t begin, uintptr_t end, int kind) {
+    begin = (begin + sizeof(void *) - 1) & ~(uintptr_t) (sizeof(void *) - 1);
+    if (scan->blockCount == 0 || end < begin + sizeof(void *))
+        return;
+    uintptr_t minAddress = scan->blocks[0].begin, maxAddress = scan->blocks[scan->blockCount - 1].end;
+    for (uintptr_t current = begin; current + sizeof(void *) <= end; current += sizeof(void *)) {
+        uintptr_t ref = *(uintptr_t *) current;
+        if (ref < minAddress || ref >= maxAddress)
+            continue;
+        int index = mcFindBlock(scan, ref);
+        if (index < 0 || scan->blocks[index].kind != MC_UNSEEN)
+            continue;
+        scan->blocks[index].kind = kind;
+        scan->pending[scan->pendingCount++] = index;
+    }
+}
+
+void mcDrainPending(mcLeakScan *scan, int kind) {
+    while (scan->pendingCount > 0) {
+        mcBlock *block = scan->blocks + scan->pending[--scan->pendingCount];
+        mcScanRange(scan, block->begin, block->end, kind);
+    }
+}
+
+#ifdef __linux__
+int mcScanSegment(struct dl_phdr_info *info, size_t size, void *closure) {
+    for (int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr) *header = info->dlpi_phdr + i;
+        if (header->p_type != PT_LOAD || !(header->p_flags & PF_W))
+            continue;
+        uintptr_t begin = info->dlpi_addr + header->p_vaddr;
+        mcScanRange((mcLeakScan *) closure, begin, begin + header->p_memsz, mcStillReachable);
+    }
+    return 0;
+}
+#endif
+
+//stackFrame is the lowest live stack address of the caller, NULL skips the stack.
+void mcScanRoots(mcLeakScan *scan, void *stackFrame) {
+#ifdef __linux__
+    dl_iterate_phdr(mcScanSegment, scan);
+    pthread_attr_t attributes;
+    if (stackFrame != NULL && pthread_getattr_np(pthread_self(), &attributes) == 0) {
+        void *stackAddr;
+        size_t stackSize;
+        pthread_attr_getstack(&attributes, &stackAddr, &stackSize);
+        pthread_attr_destroy(&attributes);
+        mcScanRange(scan, (uintptr_t) stackFrame, (uintptr_t) stackAddr + stackSize, mcStillReachable);
+    }
+#endif
+    mcDrainPending(scan, mcStillReachable);
+}
+
+void mcOutputBlocks(mcLeakScan *scan, int kind, const char *title) {
+    int printed = 0;
+    for (int i = 0; i < scan->blockCount; ++i) {
+        if (scan->blocks[i].kind != kind)
+            continue;
+        if (printed++ == 0)
+            printf("%s:\n", title);
+        outputTraverse(i, scan->blocks[i].record);
+    }
+}
+
+//verbose 0 prints nothing, 1 the summary and the lost blocks, 2 also lists every still reachable block.
+mcLeakSummary mcCheckLeaksFrom(void *stackFrame, int verbose) {
+    mcLeakSummary summary = {{0, 0, 0}, {0, 0, 0}};
+    int blockCount = mcMallocList.length;
+    if (blockCount == 0)
+        return summary;
+    mcLeakScan scan = {oriMalloc(blockCount * sizeof(mcBlock)), 0, oriMalloc(blockCount * sizeof(int)), 0};
+    if (scan.blocks == NULL || scan.pending == NULL) {
+        oriFree(scan.blocks);
+        oriFree(scan.pending);
+        return summary;
+    }
+    for (struct mcLinkedNode *node = mcMallocList.head; node != NULL; node = node->next) {
+        mcMallocRecord *record = (mcMallocRecord *) node->data;
+        uintptr_t begin = (uintptr_t) record->mallocAddr;
+        mcBlock block = {begin, begin + (record->mallocSize ? record->mallocSize : 1), record, MC_UNSEEN};
+        scan.blocks[scan.blockCount++] = block;
+    }
+    qsort(scan.blocks, scan.blockCount, sizeof(mcBlock), mcCompareBlocks);
+
+    mcScanRoots(&scan, stackFrame);
+    for (int i = 0; i < scan.blockCount; ++i) {
+        mcBlock *leader = scan.blocks + i;
+        if (leader->kind != MC_UNSEEN)
+            continue;
+        //A leader reached back through a cycle of its own stays definitely lost.
+        leader->kind = MC_LEADER;
+        mcScanRange(&scan, leader->begin, leader->end, mcIndirectlyLost);
+        mcDrainPending(&scan, mcIndirectlyLost);
+        if (leader->kind == MC_LEADER)
+            leader->kind = MC_UNSEEN;
+    }
+    for (int i = 0; i < scan.blockCount; ++i) {
+        if (scan.blocks[i].kind == MC_UNSEEN)
+            scan.blocks[i].kind = mcDefinitelyLost;
+        summary.blockCount[scan.blocks[i].kind] += 1;
+        summary.byteCount[scan.blocks[i].kind] += scan.blocks[i].record->mallocSize;
+    }
+
+    if (verbose) {
+        printf("\tDefinitely lost: %d blocks, %zu bytes.\n", summary.blockCount[mcDefinitelyLost],
+               summary.byteCount[mcDefinitelyLost]);
+        printf("\tIndirectly lost: %d blocks, %zu bytes.\n", summary.blockCount[mcIndirectlyLost],
+               summary.byteCount[mcIndirectlyLost]);
+        printf("\tStill reachable: %d blocks, %zu bytes.\n", summary.blockCount[mcStillReachable],
+               summary.byteCount[mcStillReachable]);
+        mcOutputBlocks(&scan, mcDefinitelyLost, "Definitely lost");
+        mcOutputBlocks(&scan, mcIndirectlyLost, "Indirectly lost");
+        if (verbose > 1)
+            mcOutputBlocks(&scan, mcStillReachable, "Still reachable");
+    }
+    oriFree(scan.blocks);
+    oriFree(scan.pending);
+    return summary;
+}
+
+//The scan starts at the registers spilled into this frame, deeper frames of the checker itself are not roots.
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+mcLeakSummary mcCheckLeaks(int verbose) {
+    jmp_buf registers;
+    memset(&registers, 0, sizeof(registers));
+#ifdef __GNUC__
+    __builtin_unwind_init();
+#endif
+    setjmp(registers);
+    return mcCheckLeaksFrom(&registers, verbose);
+}
+
 void mcOnExitMemoryCheck(void) {
     printf("\nSummary:\n");
     printf("\t%d valid malloc calls, %d valid free calls, total %d bytes allocated.\n", mcMallocCount, mcFreeCount,
            mcMallocBytes);
     if (mcMallocList.length != 0) {
-        printf("Possible memory leak detected:\n");
-        mcLinkedListIterate(&mcMallocList, outputTraverse);
+        mcCheckLeaksFrom(NULL, 1);
     } else {
         printf("No possible memory leak detected.\n");
     }
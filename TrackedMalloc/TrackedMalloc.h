@@ -13,6 +13,7 @@ typedef struct {
     struct mcLinkedNode *head;
     int length;
     int dataSize;
+    struct mcLinkedNode *tail;
 } mcLinkedList;
 
 typedef struct {
@@ -23,9 +24,21 @@ typedef struct {
     const char *srcFunc;
 } mcMallocRecord;
 
+typedef enum {
+    mcStillReachable,
+    mcIndirectlyLost,
+    mcDefinitelyLost
+} mcLeakKind;
+
+typedef struct {
+    int blockCount[3];
+    size_t byteCount[3];
+} mcLeakSummary;
+
 
 void *mcMalloc(size_t size, const char *file, int line, const char *func);
 void mcFree(void *ptr);
+mcLeakSummary mcCheckLeaks(int verbose);
 
 #define malloc(ARG) mcMalloc( ARG, __FILE__, __LINE__, __FUNCTION__)
 #define free(ARG) mcFree( ARG )